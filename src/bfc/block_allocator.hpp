@@ -0,0 +1,341 @@
+#ifndef __BFC_BLOCK_ALLOCATOR_HPP__
+#define __BFC_BLOCK_ALLOCATOR_HPP__
+
+#include <sys/mman.h>
+#include <sys/unistd.h>
+
+#include <new>
+#include <algorithm>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace bfc
+{
+
+// Backing allocators for the memory pools, a pool asks its allocator for a
+// block whenever its free list is empty.
+
+// Every block is a separate aligned operator new[].
+struct heap_block_allocator
+{
+    std::byte* allocate(size_t p_size, size_t p_alignment)
+    {
+        return (std::byte*) operator new[](p_size, std::align_val_t{p_alignment});
+    }
+
+    void deallocate(std::byte* p_ptr, size_t, size_t p_alignment)
+    {
+        operator delete[](p_ptr, std::align_val_t{p_alignment});
+    }
+};
+
+enum mmap_flags : int
+{
+    mmap_none = 0,
+    // MAP_HUGETLB, falling back to transparent huge pages via madvise.
+    mmap_hugepages = 1,
+    // Fault the pages in when the region is mapped.
+    mmap_populate = 2,
+    // mlock the regions so they are never swapped out.
+    mmap_lock = 4,
+};
+
+// Carves blocks out of large mmap'd regions which are only unmapped when the
+// last copy of the allocator is gone. Copies share the same regions, so the
+// size classes of a log2_memory_pool can share one set of huge pages.
+// Deallocated blocks are kept for later allocations and their pages given
+// back with MADV_DONTNEED, except for locked regions, so a trimmed pool
+// neither keeps the memory nor makes the mapping grow.
+class mmap_block_allocator
+{
+public:
+    static constexpr size_t huge_page_size = 2*1024*1024;
+
+    mmap_block_allocator(size_t p_region_size = huge_page_size, int p_flags = mmap_hugepages)
+        : m_arena(std::make_shared<arena>(p_region_size, p_flags))
+    {}
+
+    std::byte* allocate(size_t p_size, size_t p_alignment)
+    {
+        return m_arena->allocate(p_size, p_alignment);
+    }
+
+    void deallocate(std::byte* p_ptr, size_t p_size, size_t)
+    {
+        m_arena->deallocate(p_ptr, p_size);
+    }
+
+    // Maps regions for at least p_size bytes ahead of time, so the first
+    // allocations neither mmap nor take page faults when populating.
+    void reserve(size_t p_size)
+    {
+        m_arena->reserve(p_size);
+    }
+
+    size_t mapped() const
+    {
+        return m_arena->mapped();
+    }
+
+private:
+    class arena
+    {
+    public:
+        arena(size_t p_region_size, int p_flags)
+            : m_flags(p_flags)
+        {
+            size_t granularity = (m_flags & mmap_hugepages) ? huge_page_size : sysconf(_SC_PAGESIZE);
+            m_region_size = round_up(std::max(p_region_size, size_t(1)), granularity);
+        }
+
+        arena(const arena&) = delete;
+        void operator=(const arena&) = delete;
+
+        ~arena()
+        {
+            for (auto& region : m_regions)
+            {
+                munmap(region.base, region.size);
+            }
+        }
+
+        std::byte* allocate(size_t p_size, size_t p_alignment)
+        {
+            std::unique_lock<std::mutex> lg(m_mtx);
+            if (auto rv = reuse(p_size, p_alignment))
+            {
+                return rv;
+            }
+
+            for (size_t i = m_current; i < m_regions.size(); i++)
+            {
+                auto& region = m_regions[i];
+                auto offset = aligned_offset(region, p_alignment);
+                if (offset + p_size <= region.size)
+                {
+                    region.used = offset + p_size;
+                    m_current = i;
+                    return region.base + offset;
+                }
+            }
+
+            // Regions are only page aligned without huge pages, leave room
+            // to align larger alignments by hand.
+            size_t slack = p_alignment > size_t(sysconf(_SC_PAGESIZE)) ? p_alignment : 0;
+            auto& region = map(round_up(p_size + slack, m_region_size));
+            m_current = m_regions.size() - 1;
+            auto offset = aligned_offset(region, p_alignment);
+            region.used = offset + p_size;
+            return region.base + offset;
+        }
+
+        void deallocate(std::byte* p_ptr, size_t p_size)
+        {
+            if (!(m_flags & mmap_lock))
+            {
+                // Only whole pages inside the range, best effort.
+                size_t page = sysconf(_SC_PAGESIZE);
+                auto first = round_up(uintptr_t(p_ptr), page);
+                auto last = (uintptr_t(p_ptr) + p_size) / page * page;
+                if (first < last)
+                {
+                    madvise((void*) first, last - first, MADV_DONTNEED);
+                }
+            }
+
+            std::unique_lock<std::mutex> lg(m_mtx);
+            auto next = std::lower_bound(m_free.begin(), m_free.end(), p_ptr,
+                [](const range_t& p_range, std::byte* p_base){ return p_range.base < p_base; });
+            if (next != m_free.end() && p_ptr + p_size == next->base)
+            {
+                next->base = p_ptr;
+                next->size += p_size;
+            }
+            else
+            {
+                next = m_free.insert(next, range_t{p_ptr, p_size});
+            }
+            if (next != m_free.begin())
+            {
+                auto prev = next - 1;
+                if (prev->base + prev->size == next->base)
+                {
+                    prev->size += next->size;
+                    m_free.erase(next);
+                }
+            }
+        }
+
+        void reserve(size_t p_size)
+        {
+            std::unique_lock<std::mutex> lg(m_mtx);
+            size_t available = 0;
+            for (size_t i = m_current; i < m_regions.size(); i++)
+            {
+                available += m_regions[i].size - m_regions[i].used;
+            }
+
+            while (available < p_size)
+            {
+                available += map(m_region_size).size;
+            }
+        }
+
+        size_t mapped() const
+        {
+            std::unique_lock<std::mutex> lg(m_mtx);
+            size_t rv = 0;
+            for (auto& region : m_regions)
+            {
+                rv += region.size;
+            }
+            return rv;
+        }
+
+    private:
+        struct region_t
+        {
+            std::byte* base;
+            size_t size;
+            size_t used;
+        };
+
+        struct range_t
+        {
+            std::byte* base;
+            size_t size;
+        };
+
+        // First fit among the deallocated ranges, what is left of the range
+        // on either side of the block stays free.
+        std::byte* reuse(size_t p_size, size_t p_alignment)
+        {
+            for (auto it = m_free.begin(); it != m_free.end(); it++)
+            {
+                auto base = (std::byte*) round_up(uintptr_t(it->base), p_alignment);
+                auto end = it->base + it->size;
+                if (base > end || size_t(end - base) < p_size)
+                {
+                    continue;
+                }
+
+                range_t head{it->base, size_t(base - it->base)};
+                range_t tail{base + p_size, size_t(end - base - p_size)};
+                if (head.size && tail.size)
+                {
+                    *it = tail;
+                    m_free.insert(it, head);
+                }
+                else if (head.size)
+                {
+                    *it = head;
+                }
+                else if (tail.size)
+                {
+                    *it = tail;
+                }
+                else
+                {
+                    m_free.erase(it);
+                }
+                return base;
+            }
+            return nullptr;
+        }
+
+        static size_t round_up(size_t p_size, size_t p_alignment)
+        {
+            return ((p_size + p_alignment - 1) / p_alignment) * p_alignment;
+        }
+
+        static size_t aligned_offset(const region_t& p_region, size_t p_alignment)
+        {
+            auto used = uintptr_t(p_region.base) + p_region.used;
+            return round_up(used, p_alignment) - uintptr_t(p_region.base);
+        }
+
+        region_t& map(size_t p_size)
+        {
+            int populate = (m_flags & mmap_populate) ? MAP_POPULATE : 0;
+            void* base = MAP_FAILED;
+
+            if (m_flags & mmap_hugepages)
+            {
+                base = mmap(nullptr, p_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB|populate, -1, 0);
+                if (MAP_FAILED == base)
+                {
+                    base = map_transparent_huge(p_size);
+                }
+            }
+            else
+            {
+                base = mmap(nullptr, p_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|populate, -1, 0);
+            }
+
+            if (MAP_FAILED == base)
+            {
+                throw std::bad_alloc();
+            }
+
+            if ((m_flags & mmap_lock) && mlock(base, p_size))
+            {
+                auto err = errno;
+                munmap(base, p_size);
+                throw std::runtime_error(strerror(err));
+            }
+
+            m_regions.emplace_back(region_t{(std::byte*) base, p_size, 0});
+            return m_regions.back();
+        }
+
+        // Maps a huge page aligned region and asks for transparent huge pages,
+        // populating by touching the pages so the fault gets huge pages too.
+        void* map_transparent_huge(size_t p_size)
+        {
+            auto raw = (std::byte*) mmap(nullptr, p_size + huge_page_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+            if (MAP_FAILED == (void*) raw)
+            {
+                return MAP_FAILED;
+            }
+
+            auto base = (std::byte*) round_up(uintptr_t(raw), huge_page_size);
+            if (base != raw)
+            {
+                munmap(raw, base - raw);
+            }
+            munmap(base + p_size, (raw + p_size + huge_page_size) - (base + p_size));
+
+            madvise(base, p_size, MADV_HUGEPAGE);
+
+            if (m_flags & mmap_populate)
+            {
+                size_t page = sysconf(_SC_PAGESIZE);
+                for (size_t i = 0; i < p_size; i += page)
+                {
+                    *(volatile std::byte*)(base + i) = std::byte{};
+                }
+            }
+
+            return base;
+        }
+
+        const int m_flags;
+        size_t m_region_size;
+        size_t m_current = 0;
+        std::vector<region_t> m_regions;
+        // Deallocated ranges sorted by address, neighbours merged.
+        std::vector<range_t> m_free;
+        mutable std::mutex m_mtx;
+    };
+
+    std::shared_ptr<arena> m_arena;
+};
+
+} // namespace bfc
+
+#endif // __BFC_BLOCK_ALLOCATOR_HPP__
@@ -0,0 +1,126 @@
+#ifndef __BFC_BUFFER_CHAIN_HPP__
+#define __BFC_BUFFER_CHAIN_HPP__
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include <bfc/buffer.hpp>
+
+namespace bfc
+{
+
+// Non-owning list of up to N contiguous segments laid out as an iovec array
+// so it can be handed to writev/readv/sendmsg/recvmsg as is. The segments
+// must outlive the chain.
+template <size_t N = 8>
+class buffer_chain
+{
+public:
+    buffer_chain() = default;
+
+    template <typename... T, std::enable_if_t<(sizeof...(T) > 0) && !(std::is_same_v<std::decay_t<T>, buffer_chain> || ...)>* = nullptr>
+    buffer_chain(T&&... p_segments)
+    {
+        (push_back(std::forward<T>(p_segments)), ...);
+    }
+
+    template <typename T>
+    void push_back(T&& p_segment)
+    {
+        push_back(p_segment.data(), p_segment.size());
+    }
+
+    template <typename U>
+    void push_back(U* p_data, size_t p_size)
+    {
+        static_assert(sizeof(U)==1);
+        if (N == m_count)
+        {
+            throw std::length_error("buffer_chain full");
+        }
+        m_segments[m_count++] = iovec{(void*) p_data, p_size};
+    }
+
+    // Drops the first p_size bytes, e.g. the part already written by a
+    // partial send, and returns the number of bytes left.
+    size_t consume(size_t p_size)
+    {
+        size_t index = 0;
+        while (index < m_count && p_size >= m_segments[index].iov_len)
+        {
+            p_size -= m_segments[index].iov_len;
+            index++;
+        }
+
+        if (index < m_count)
+        {
+            m_segments[index].iov_base = (std::byte*) m_segments[index].iov_base + p_size;
+            m_segments[index].iov_len -= p_size;
+        }
+
+        for (size_t i = index; i < m_count; i++)
+        {
+            m_segments[i - index] = m_segments[i];
+        }
+        m_count -= index;
+
+        return size();
+    }
+
+    void clear()
+    {
+        m_count = 0;
+    }
+
+    // Total number of bytes in all segments.
+    size_t size() const
+    {
+        size_t rv = 0;
+        for (size_t i = 0; i < m_count; i++)
+        {
+            rv += m_segments[i].iov_len;
+        }
+        return rv;
+    }
+
+    bool empty() const
+    {
+        return 0 == size();
+    }
+
+    size_t count() const
+    {
+        return m_count;
+    }
+
+    static constexpr size_t capacity()
+    {
+        return N;
+    }
+
+    buffer_view operator[](size_t p_index) const
+    {
+        return buffer_view((std::byte*) m_segments[p_index].iov_base, m_segments[p_index].iov_len);
+    }
+
+    const iovec* iov() const
+    {
+        return m_segments;
+    }
+
+    iovec* iov()
+    {
+        return m_segments;
+    }
+
+private:
+    iovec m_segments[N];
+    size_t m_count = 0;
+};
+
+} // namespace bfc
+
+#endif // __BFC_BUFFER_CHAIN_HPP__
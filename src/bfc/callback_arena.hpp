@@ -0,0 +1,236 @@
+#ifndef __BFC_CALLBACK_ARENA_HPP__
+#define __BFC_CALLBACK_ARENA_HPP__
+
+#include <new>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+
+#include <bfc/function.hpp>
+
+namespace bfc
+{
+
+// Packs callables of different types back to back in reusable chunks, each
+// one preceded by a header pointing to its type's operations. Chunks are
+// kept across invoke_and_clear() so a warmed up arena does not allocate.
+template <typename T, size_t CHUNK_SIZE = 4096>
+class callback_arena;
+template <typename... args_t, size_t CHUNK_SIZE>
+class callback_arena<void(args_t...), CHUNK_SIZE>
+{
+public:
+    callback_arena() = default;
+    callback_arena(const callback_arena&) = delete;
+    void operator=(const callback_arena&) = delete;
+
+    callback_arena(callback_arena&& p_other) noexcept
+    {
+        swap(p_other);
+    }
+
+    callback_arena& operator=(callback_arena&& p_other) noexcept
+    {
+        clear();
+        swap(p_other);
+        return *this;
+    }
+
+    ~callback_arena()
+    {
+        clear();
+    }
+
+    template <typename callable_t>
+    void emplace(callable_t&& p_obj)
+    {
+        using callable_tType = std::decay_t<callable_t>;
+        static_assert(alignof(callable_tType) <= ALIGNMENT);
+
+        auto size = align(sizeof(header_t)) + align(sizeof(callable_tType));
+        auto block = reserve(size);
+        new (block + align(sizeof(header_t))) callable_tType(std::forward<callable_t>(p_obj));
+        new (block) header_t{&ops<callable_tType>, size};
+        m_chunks[m_current].used += size;
+        m_size++;
+    }
+
+    // Invokes every callable in insertion order, destroying each right after
+    // it is called. Callables emplaced during the walk are not allowed, swap
+    // with another arena first when that is needed.
+    void invoke_and_clear(args_t... p_args)
+    {
+        walk([&](const ops_t* p_ops, std::byte* p_obj) {
+                p_ops->invoke(p_obj, p_args...);
+            });
+    }
+
+    void clear()
+    {
+        walk([](const ops_t*, std::byte*) {});
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return 0 == m_size;
+    }
+
+    void swap(callback_arena& p_other) noexcept
+    {
+        std::swap(m_chunks, p_other.m_chunks);
+        std::swap(m_current, p_other.m_current);
+        std::swap(m_size, p_other.m_size);
+    }
+
+private:
+    static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+    struct ops_t
+    {
+        void (*invoke)(void*, args_t...);
+        void (*destroy)(void*);
+    };
+
+    struct header_t
+    {
+        const ops_t* ops;
+        size_t size;
+    };
+
+    struct chunk_deleter
+    {
+        void operator()(std::byte* p_ptr) const
+        {
+            operator delete[](p_ptr, std::align_val_t{ALIGNMENT});
+        }
+    };
+
+    struct chunk_t
+    {
+        std::unique_ptr<std::byte[], chunk_deleter> data;
+        size_t capacity = 0;
+        size_t used = 0;
+    };
+
+    static constexpr size_t align(size_t p_size)
+    {
+        return (p_size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    template <typename callable_tType>
+    static void invoke(void* p_obj, args_t... p_args)
+    {
+        (*(callable_tType*)p_obj)(std::forward<args_t>(p_args)...);
+    }
+
+    template <typename callable_tType>
+    static void destroy(void* p_obj)
+    {
+        ((callable_tType*)p_obj)->~callable_tType();
+    }
+
+    template <typename callable_tType>
+    static constexpr ops_t ops = {&invoke<callable_tType>, &destroy<callable_tType>};
+
+    std::byte* reserve(size_t p_size)
+    {
+        while (m_current < m_chunks.size())
+        {
+            auto& chunk = m_chunks[m_current];
+            if (chunk.capacity - chunk.used >= p_size)
+            {
+                return chunk.data.get() + chunk.used;
+            }
+
+            if (0 == chunk.used)
+            {
+                // Too small even empty, replace it with one that fits.
+                break;
+            }
+
+            m_current++;
+        }
+
+        if (m_current == m_chunks.size())
+        {
+            m_chunks.emplace_back();
+        }
+
+        auto& chunk = m_chunks[m_current];
+        chunk.capacity = std::max(CHUNK_SIZE, p_size);
+        chunk.data.reset((std::byte*) operator new[](chunk.capacity, std::align_val_t{ALIGNMENT}));
+        return chunk.data.get();
+    }
+
+    // Destroys every callable after passing it to p_fn, the arena is empty
+    // afterwards even if p_fn throws.
+    template <typename fn_t>
+    void walk(fn_t&& p_fn)
+    {
+        size_t chunk_index = 0;
+        size_t offset = 0;
+        auto next = [&]() -> header_t* {
+                while (chunk_index <= m_current && chunk_index < m_chunks.size())
+                {
+                    auto& chunk = m_chunks[chunk_index];
+                    if (offset < chunk.used)
+                    {
+                        auto header = (header_t*)(chunk.data.get() + offset);
+                        offset += header->size;
+                        return header;
+                    }
+                    chunk.used = 0;
+                    chunk_index++;
+                    offset = 0;
+                }
+                return nullptr;
+            };
+
+        try
+        {
+            while (auto header = next())
+            {
+                auto obj = (std::byte*) header + align(sizeof(header_t));
+                auto obj_ops = header->ops;
+                try
+                {
+                    p_fn(obj_ops, obj);
+                }
+                catch (...)
+                {
+                    obj_ops->destroy(obj);
+                    throw;
+                }
+                obj_ops->destroy(obj);
+            }
+        }
+        catch (...)
+        {
+            while (auto header = next())
+            {
+                header->ops->destroy((std::byte*) header + align(sizeof(header_t)));
+            }
+            m_current = 0;
+            m_size = 0;
+            throw;
+        }
+
+        m_current = 0;
+        m_size = 0;
+    }
+
+    std::vector<chunk_t> m_chunks;
+    size_t m_current = 0;
+    size_t m_size = 0;
+};
+
+} // namespace bfc
+
+#endif // __BFC_CALLBACK_ARENA_HPP__
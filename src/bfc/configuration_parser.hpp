@@ -8,26 +8,62 @@
 #include <string>
 #include <regex>
 #include <map>
+#include <memory>
+#include <string_view>
+#include <type_traits>
 
 namespace bfc
 {
 
-class args_map : public std::map<std::string, std::string>
+namespace detail
+{
+
+template <typename allocator_t, typename compare_t>
+struct args_map_types
+{
+    template <typename U>
+    using rebind_t = typename std::allocator_traits<allocator_t>::template rebind_alloc<U>;
+    using string_t = std::basic_string<char, std::char_traits<char>, rebind_t<char>>;
+    using compare_type = std::conditional_t<std::is_void_v<compare_t>, std::less<string_t>, compare_t>;
+    using map_t = std::map<string_t, string_t, compare_type, rebind_t<std::pair<const string_t, string_t>>>;
+};
+
+template <typename T, typename = void>
+struct is_transparent : std::false_type
+{};
+
+template <typename T>
+struct is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type
+{};
+
+} // namespace detail
+
+// Keys and values are strings using allocator_t rebound to char, the map
+// nodes use it rebound to the node type. Keys are ordered by compare_t,
+// std::less<string_t> when void, so args_map is a plain
+// std::map<std::string, std::string>. With a transparent compare_t such as
+// std::less<> lookups do not build a key string.
+template <typename allocator_t = std::allocator<char>, typename compare_t = void>
+class basic_args_map : public detail::args_map_types<allocator_t, compare_t>::map_t
 {
 public:
-    args_map() = default;
+    using string_t = typename detail::args_map_types<allocator_t, compare_t>::string_t;
+    using map_t = typename detail::args_map_types<allocator_t, compare_t>::map_t;
+    using map_t::map_t;
+
+    basic_args_map() = default;
 
     template<typename T>
     std::optional<T> as(const std::string_view& p_key) const
     {
-        auto findit = find(p_key.data());
-        if (findit == end())
+        auto findit = find_key(p_key);
+        if (findit == this->end())
         {
             return std::nullopt;
         }
 
         T rv;
-        std::istringstream iss(findit->second);
+        std::istringstream iss(std_string(findit->second));
         iss >> rv;
         if (iss.fail())
         {
@@ -39,15 +75,42 @@ public:
 
     std::optional<std::string> arg(const std::string_view& p_key) const
     {
-        auto findit = find(p_key.data());
-        if (findit == end())
+        auto findit = find_key(p_key);
+        if (findit == this->end())
         {
             return std::nullopt;
         }
-        return findit->second;
+        return std_string(findit->second);
+    }
+
+private:
+    auto find_key(const std::string_view& p_key) const
+    {
+        if constexpr (detail::is_transparent<typename map_t::key_compare>::value)
+        {
+            return this->find(p_key);
+        }
+        else
+        {
+            return this->find(string_t(p_key, this->get_allocator()));
+        }
+    }
+
+    static const std::string& std_string(const std::string& p_str)
+    {
+        return p_str;
+    }
+
+    template <typename string_tType>
+    static std::string std_string(const string_tType& p_str)
+    {
+        return std::string(p_str.data(), p_str.size());
     }
 };
 
+using args_map = basic_args_map<>;
+using transparent_args_map = basic_args_map<std::allocator<char>, std::less<>>;
+
 class configuration_parser : public args_map
 {
 public:
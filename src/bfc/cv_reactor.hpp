@@ -4,18 +4,21 @@
 #include <condition_variable>
 #include <atomic>
 #include <mutex>
-#include <list>
 
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/unistd.h>
 
 #include <bfc/function.hpp>
+#include <bfc/callback_arena.hpp>
 #include <bfc/event_queue.hpp>
+#include <bfc/idle_policy.hpp>
 
 namespace bfc
 {
 
+// run() waits for wake ups as p_idle says before it sleeps on the condition
+// variable, wake_up() only notifies the loop when it is asleep.
 template <typename T, typename cb_t = light_function<void()>>
 class cv_reactor
 {
@@ -25,8 +28,9 @@ public:
     cv_reactor(const cv_reactor&) = delete;
     void operator=(const cv_reactor&) = delete;
 
-    cv_reactor(uint64_t timeout=100)
+    cv_reactor(uint64_t timeout=100, const idle_policy& p_idle = {})
         : m_timeout_ms(timeout)
+        , m_idle(p_idle)
     {}
 
     ~cv_reactor()
@@ -54,28 +58,29 @@ public:
         return true;
     }
 
-    void run(cb_t cb = nullptr)
+    void run(function_ref<void()> cb = nullptr)
     {
         m_running = true;
         while (m_running)
         {
+            m_idle.wait([this](){return m_wakeup_req.load(std::memory_order_acquire);});
+
             {
                 std::unique_lock lg(m_wakeup_mtx);
 
+                m_sleeping = true;
                 m_cv.wait_for(lg, std::chrono::milliseconds(m_timeout_ms), [this]()
                     {
-                        return m_wakeup_req;
+                        return m_wakeup_req.load(std::memory_order_relaxed);
                     });
+                m_sleeping = false;
 
                 if (m_wakeup_req)
                 {
                     m_wakeup_req = false;
-                    auto cb_list = std::move(m_wakeup_cb_list);
+                    m_wakeup_cb_list.swap(m_wakeup_cb_run);
                     lg.unlock();
-                    for (auto& cb : cb_list)
-                    {
-                        cb();
-                    }
+                    m_wakeup_cb_run.invoke_and_clear();
                 }
             }
 
@@ -86,15 +91,29 @@ public:
         }
     }
 
-    void wake_up(cb_t cb = nullptr)
+    void wake_up()
+    {
+        std::unique_lock lg(m_wakeup_mtx);
+        m_wakeup_req.store(true, std::memory_order_release);
+        if (m_sleeping)
+        {
+            m_cv.notify_one();
+        }
+    }
+
+    template <typename callable_t>
+    void wake_up(callable_t&& cb)
     {
         std::unique_lock lg(m_wakeup_mtx);
-        if (cb)
+        if (!is_null_callable(cb))
+        {
+            m_wakeup_cb_list.emplace(std::forward<callable_t>(cb));
+        }
+        m_wakeup_req.store(true, std::memory_order_release);
+        if (m_sleeping)
         {
-            m_wakeup_cb_list.emplace_back(std::move(cb));
+            m_cv.notify_one();
         }
-        m_wakeup_req = true;
-        m_cv.notify_one();
     }
 
     void stop()
@@ -105,10 +124,13 @@ public:
 
  private:
     size_t m_timeout_ms = 100;
+    const idle_policy m_idle;
 
     std::mutex m_wakeup_mtx;
-    bool m_wakeup_req = false;
-    std::list<cb_t> m_wakeup_cb_list;
+    std::atomic<bool> m_wakeup_req = false;
+    bool m_sleeping = false;
+    callback_arena<void()> m_wakeup_cb_list;
+    callback_arena<void()> m_wakeup_cb_run;
     std::condition_variable m_cv;
 
     bool m_running;
@@ -10,6 +10,8 @@
 #include <sys/unistd.h>
 
 #include <bfc/function.hpp>
+#include <bfc/callback_arena.hpp>
+#include <bfc/memory_resource.hpp>
 
 namespace bfc
 {
@@ -30,8 +32,11 @@ struct epoll_reactor
     epoll_reactor(const epoll_reactor&) = delete;
     void operator=(const epoll_reactor&) = delete;
 
-    epoll_reactor(size_t p_cache_size = 64)
+    epoll_reactor(size_t p_cache_size = 64, size_t p_scratch_chunk = monotonic_arena::default_chunk_size,
+        std::pmr::memory_resource* p_scratch_fallback = std::pmr::new_delete_resource(),
+        size_t p_scratch_retained = monotonic_arena::unlimited)
         : m_event_cache(p_cache_size)
+        , m_scratch(p_scratch_chunk, p_scratch_fallback, p_scratch_retained)
         , m_epoll_fd(epoll_create1(0))
     {
         m_event_fd = eventfd(0, EFD_SEMAPHORE);
@@ -74,8 +79,11 @@ struct epoll_reactor
         return epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, ctx.fd, &(ctx.event));
     }
 
-    void run(cb_t cb = nullptr)
+    // Scratch allocations made by the callbacks of an iteration, through
+    // scratch() or scratch_resource(), are released together at its end.
+    void run(function_ref<void()> cb = nullptr)
     {
+        scoped_scratch scratch_scope(m_scratch);
         m_running = true;
         while (m_running)
         {
@@ -100,44 +108,56 @@ struct epoll_reactor
 
             {
                 std::unique_lock lg(m_wake_up_cb_mtx);
-                for (auto& cb : m_wake_up_cb)
-                {
-                    cb();
-                }
-
-                m_wake_up_cb.clear();
+                m_wake_up_cb.swap(m_wake_up_cb_run);
             }
 
+            m_wake_up_cb_run.invoke_and_clear();
+
             if (cb)
             {
                 cb();
             }
+
+            m_scratch.reset();
         }
     }
 
+    monotonic_arena& scratch()
+    {
+        return m_scratch;
+    }
+
     void stop()
     {
         m_running = false;
         wake_up();
     }
 
-    void wake_up(cb_t cb = nullptr)
+    void wake_up()
     {
-        if (cb)
+        uint64_t one = 1;
+        auto res [[maybe_unused]] = write(m_event_fd, &one, sizeof(one));
+    }
+
+    template <typename callable_t>
+    void wake_up(callable_t&& cb)
+    {
+        if (!is_null_callable(cb))
         {
             std::unique_lock lg(m_wake_up_cb_mtx);
-            m_wake_up_cb.emplace_back(std::move(cb));
+            m_wake_up_cb.emplace(std::forward<callable_t>(cb));
         }
 
-        uint64_t one = 1;
-        auto res [[maybe_unused]] = write(m_event_fd, &one, sizeof(one));
+        wake_up();
     }
 
 private:
     std::vector<epoll_event> m_event_cache;
+    monotonic_arena m_scratch;
 
     std::mutex m_wake_up_cb_mtx;
-    std::vector<cb_t> m_wake_up_cb;
+    callback_arena<void()> m_wake_up_cb;
+    callback_arena<void()> m_wake_up_cb_run;
 
     int m_epoll_fd;
     int m_event_fd;
@@ -210,7 +230,13 @@ public:
     epoll_reactor(const epoll_reactor&) = delete;
     void operator=(const epoll_reactor&) = delete;
 
-    epoll_reactor(){}
+    // Scratch chunks come from p_scratch_fallback, at most
+    // p_scratch_retained bytes of them are kept between iterations.
+    epoll_reactor(size_t p_scratch_chunk = monotonic_arena::default_chunk_size,
+        std::pmr::memory_resource* p_scratch_fallback = std::pmr::new_delete_resource(),
+        size_t p_scratch_retained = monotonic_arena::unlimited)
+        : m_reactor(64, p_scratch_chunk, p_scratch_fallback, p_scratch_retained)
+    {}
     ~epoll_reactor(){}
 
     context make_context(fd_t fd)
@@ -263,14 +289,15 @@ public:
         return m_reactor.mod(ctx.writer) == 0;
     }
 
-    void wake_up(cb_t cb)
+    template <typename callable_t>
+    void wake_up(callable_t&& cb)
     {
-        m_reactor.wake_up(std::move(cb));
+        m_reactor.wake_up(std::forward<callable_t>(cb));
     }
 
-    void run(cb_t cb = nullptr)
+    void run(function_ref<void()> cb = nullptr)
     {
-        m_reactor.run(std::move(cb));
+        m_reactor.run(cb);
     }
 
     void stop()
@@ -278,6 +305,12 @@ public:
         m_reactor.stop();
     }
 
+    // Per iteration arena, only to be used from the loop's thread.
+    monotonic_arena& scratch()
+    {
+        return m_reactor.scratch();
+    }
+
 private:
     reactor_t m_reactor;
 };
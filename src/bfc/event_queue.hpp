@@ -5,22 +5,31 @@
 #include <atomic>
 #include <mutex>
 #include <deque>
+#include <memory>
+#include <vector>
 
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/unistd.h>
 
 #include <bfc/function.hpp>
+#include <bfc/idle_policy.hpp>
 
 namespace bfc
 {
 
-template <typename T, typename reactor_t, typename cb_t = light_function<void()>>
+// The queued events live in vectors using allocator_t, e.g. a
+// std::pmr::polymorphic_allocator over a pool or a per loop arena.
+template <typename T, typename reactor_t, typename cb_t = light_function<void()>, typename allocator_t = std::allocator<T>>
 class reactive_event_queue
 {
 public:
-    reactive_event_queue(reactor_t* reactor = nullptr)
-        : m_reactor (reactor)
+    using vector_t = std::vector<T, allocator_t>;
+
+    reactive_event_queue(reactor_t* reactor = nullptr, const allocator_t& p_allocator = allocator_t())
+        : m_queue(p_allocator)
+        , m_consumed(p_allocator)
+        , m_reactor (reactor)
     {}
 
     ~reactive_event_queue()
@@ -50,12 +59,25 @@ public:
         return rv;
     }
 
-    std::vector<T> pop()
+    vector_t pop()
     {
         std::unique_lock<std::mutex> lg(m_queue_mtx);
         return std::move(m_queue);
     }
 
+    // Consumes the queued events through the visitor, the vector storage is
+    // recycled between calls. Must only be called by a single consumer. If
+    // p_visitor throws, the events popped but not visited yet are dropped.
+    size_t pop(function_ref<void(T&)> p_visitor)
+    {
+        {
+            std::unique_lock<std::mutex> lg(m_queue_mtx);
+            std::swap(m_queue, m_consumed);
+        }
+
+        return visit_consumed(p_visitor);
+    }
+
     size_t size()
     {
         std::unique_lock<std::mutex> lg(m_queue_mtx);
@@ -65,20 +87,54 @@ public:
 private:
     template <typename, typename> friend class cv_reactor;
 
+    // Cleared on every exit, stale events would otherwise be swapped back
+    // into the queue by the next pop.
+    size_t visit_consumed(function_ref<void(T&)>& p_visitor)
+    {
+        try
+        {
+            for (auto& i : m_consumed)
+            {
+                p_visitor(i);
+            }
+        }
+        catch (...)
+        {
+            m_consumed.clear();
+            throw;
+        }
+
+        auto rv = m_consumed.size();
+        m_consumed.clear();
+        return rv;
+    }
+
     std::mutex m_queue_mtx;
-    std::vector<T> m_queue;
+    vector_t m_queue;
+    vector_t m_consumed;
     reactor_t* m_reactor = nullptr;
 
     std::mutex cb_mtx;
     cb_t cb;
 };
 
-template <typename T>
+// A blocking pop() waits as p_idle says before it sleeps on the condition
+// variable, push() only notifies a consumer that is asleep.
+template <typename T, typename allocator_t = std::allocator<T>>
 class event_queue
 {
 public:
-    event_queue(bool blocking = true)
+    using vector_t = std::vector<T, allocator_t>;
+
+    event_queue(bool blocking = true, const allocator_t& p_allocator = allocator_t(), const idle_policy& p_idle = {})
         : m_blocking(blocking)
+        , m_idle(p_idle)
+        , m_queue(p_allocator)
+        , m_consumed(p_allocator)
+    {}
+
+    event_queue(bool blocking, const idle_policy& p_idle, const allocator_t& p_allocator = allocator_t())
+        : event_queue(blocking, p_allocator, p_idle)
     {}
 
     ~event_queue()
@@ -89,17 +145,39 @@ public:
     {
         std::unique_lock<std::mutex> lg(m_queue_mtx);
         m_queue.emplace_back(std::forward<U>(u));
-        wake_up();
+        m_pending.store(true, std::memory_order_release);
+        if (m_sleeping)
+        {
+            wake_up();
+        }
         return m_queue.size();
     }
 
-    std::vector<T> pop()
+    vector_t pop()
     {
+        idle();
         std::unique_lock<std::mutex> lg(m_queue_mtx);
-        if (m_blocking && 0 == m_queue.size()) cv.wait(lg);
+        sleep(lg);
+        m_pending.store(false, std::memory_order_relaxed);
         return std::move(m_queue);
     }
 
+    // Consumes the queued events through the visitor, the vector storage is
+    // recycled between calls. Must only be called by a single consumer. If
+    // p_visitor throws, the events popped but not visited yet are dropped.
+    size_t pop(function_ref<void(T&)> p_visitor)
+    {
+        idle();
+        {
+            std::unique_lock<std::mutex> lg(m_queue_mtx);
+            sleep(lg);
+            m_pending.store(false, std::memory_order_relaxed);
+            std::swap(m_queue, m_consumed);
+        }
+
+        return visit_consumed(p_visitor);
+    }
+
     size_t size()
     {
         std::unique_lock<std::mutex> lg(m_queue_mtx);
@@ -116,10 +194,54 @@ public:
     }
 
 private:
+    void idle()
+    {
+        if (m_blocking)
+        {
+            m_idle.wait([this](){return m_pending.load(std::memory_order_acquire);});
+        }
+    }
+
+    void sleep(std::unique_lock<std::mutex>& p_lock)
+    {
+        if (m_blocking && 0 == m_queue.size())
+        {
+            m_sleeping++;
+            cv.wait(p_lock);
+            m_sleeping--;
+        }
+    }
+
+    // Cleared on every exit, stale events would otherwise be swapped back
+    // into the queue by the next pop.
+    size_t visit_consumed(function_ref<void(T&)>& p_visitor)
+    {
+        try
+        {
+            for (auto& i : m_consumed)
+            {
+                p_visitor(i);
+            }
+        }
+        catch (...)
+        {
+            m_consumed.clear();
+            throw;
+        }
+
+        auto rv = m_consumed.size();
+        m_consumed.clear();
+        return rv;
+    }
+
     bool m_blocking = true;
+    const idle_policy m_idle;
     std::mutex m_queue_mtx;
     std::condition_variable cv;
-    std::vector<T> m_queue;
+    size_t m_sleeping = 0;
+    std::atomic<bool> m_pending = false;
+    vector_t m_queue;
+    vector_t m_consumed;
 };
 
 } // namespace bfc
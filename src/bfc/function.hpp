@@ -4,104 +4,138 @@
 #include <cstddef>
 #include <cstring>
 #include <functional>
+#include <memory>
 
 namespace bfc
 {
 
-template <size_t N, typename return_t, typename... args_t>
-class function
-{
-public:
-    function() = default;
+// Spill policy for callables that do not fit the inline storage: disabled,
+// oversized callables fail to compile.
+struct no_spill
+{};
 
-    function(const function &p_other)
+// Spill policy that places oversized callables on the global heap.
+struct heap_spill
+{
+    static void* allocate(size_t p_size)
     {
-        if (p_other)
-        {
-            p_other.m_copier(m_object, p_other.m_object);
-        }
+        return operator new(p_size);
+    }
 
-        set(p_other);
+    static void deallocate(void* p_ptr, size_t)
+    {
+        operator delete(p_ptr);
     }
+};
+
+namespace detail
+{
+// Never constructed, not even from an empty initializer list.
+class non_copyable_function
+{
+    non_copyable_function(const void*);
+};
+
+// Per callable type operations shared by every function holding that type.
+// Null copy/move mean the storage can be memcpy'd, null destroy means there
+// is nothing to destroy.
+template <typename return_t, typename... args_t>
+struct function_ops
+{
+    return_t (*invoke)(const void *, args_t...);
+    void (*destroy)(void *);
+    void (*copy)(void *, const void *);
+    void (*move)(void *, void *);
+};
+} // namespace detail
+
+// COPYABLE=false yields a move-only function that can hold move-only
+// callables, the copy constructor and assignment then take an unrelated
+// type so the implicit ones are deleted.
+template <size_t N, bool COPYABLE, typename spill_t, typename return_t, typename... args_t>
+class basic_function
+{
+    using copy_t = std::conditional_t<COPYABLE, basic_function, detail::non_copyable_function>;
+    using ops_t = detail::function_ops<return_t, args_t...>;
 
-    function(function &&p_other)
+public:
+    // Fundamental alignment, so callables holding long double, __int128 or
+    // SSE types stay inline. Costs no space when N + sizeof(void*) is a
+    // multiple of it, as for ulight and light functions.
+    static constexpr size_t alignment = alignof(std::max_align_t);
+
+    basic_function() = default;
+
+    basic_function(const copy_t &p_other)
     {
-        if (p_other)
-        {
-            p_other.m_mover(m_object, p_other.m_object);
-        }
+        copy_from(p_other);
+    }
 
-        set(p_other);
-        p_other.clear();
+    basic_function(basic_function &&p_other) noexcept
+    {
+        move_from(p_other);
     }
 
-    template <typename callable_t, std::enable_if_t<!std::is_same_v<std::remove_reference_t<callable_t>, function>> *p = nullptr>
-    function(callable_t &&p_obj)
+    template <typename callable_t, std::enable_if_t<!std::is_same_v<std::decay_t<callable_t>, basic_function>> *p = nullptr>
+    basic_function(callable_t &&p_obj)
     {
         set(std::forward<callable_t>(p_obj));
     }
 
-    function &operator=(const function &p_other)
+    basic_function &operator=(const copy_t &p_other)
     {
-        reset();
-
-        if (p_other)
+        if (this != &p_other)
         {
-            p_other.m_copier(m_object, p_other.m_object);
+            reset();
+            copy_from(p_other);
         }
-
-        set(p_other);
         return *this;
     }
 
-    function &operator=(function &&p_other)
+    basic_function &operator=(basic_function &&p_other) noexcept
     {
-        reset();
-
-        if (p_other)
+        if (this != &p_other)
         {
-            p_other.m_mover(m_object, p_other.m_object);
+            reset();
+            move_from(p_other);
         }
-
-        set(p_other);
-        p_other.clear();
         return *this;
     }
 
-    template <typename callable_t>
-    function &operator=(callable_t &&p_obj)
+    template <typename callable_t, std::enable_if_t<!std::is_same_v<std::decay_t<callable_t>, basic_function>> *p = nullptr>
+    basic_function &operator=(callable_t &&p_obj)
     {
         reset();
         set(std::forward<callable_t>(p_obj));
         return *this;
     }
 
-    ~function()
+    ~basic_function()
     {
         reset();
     }
 
     operator bool() const
     {
-        return m_fn;
+        return m_ops;
     }
 
     void reset()
     {
-        if (m_fn)
+        if (m_ops && m_ops->destroy)
         {
-            m_destroyer(m_object);
+            m_ops->destroy(m_object);
         }
 
-        clear();
+        m_ops = nullptr;
     }
 
     template <typename... T>
     return_t operator()(T &&... pArgs) const
     {
-        if (m_fn)
+        if (m_ops)
         {
-            return m_fn(m_object, std::forward<T>(pArgs)...);
+            return m_ops->invoke(m_object, std::forward<T>(pArgs)...);
         }
         else
         {
@@ -110,68 +144,287 @@ public:
     }
 
 private:
-    template <typename callable_t, std::enable_if_t<!std::is_same_v<std::remove_reference_t<callable_t>, function>> *p = nullptr>
+    template <typename callable_tType>
+    static constexpr bool is_inline = N >= sizeof(callable_tType) && alignment >= alignof(callable_tType);
+
+    template <typename callable_tType>
+    static constexpr bool is_trivial = std::is_trivially_copyable_v<callable_tType> && std::is_trivially_destructible_v<callable_tType>;
+
+    template <typename callable_t, std::enable_if_t<!std::is_same_v<std::decay_t<callable_t>, basic_function>> *p = nullptr>
     void set(callable_t &&p_obj)
     {
         using callable_tType = std::decay_t<callable_t>;
-        static_assert(N >= sizeof(callable_tType));
-        new (m_object) callable_tType(std::forward<callable_tType>(p_obj));
-        m_destroyer = [](void *p_obj) {
-            ((callable_tType *)p_obj)->~callable_tType();
-        };
+        if constexpr (is_inline<callable_tType>)
+        {
+            new (m_object) callable_tType(std::forward<callable_t>(p_obj));
+        }
+        else
+        {
+            static_assert(alignof(callable_tType) <= alignof(std::max_align_t), "callable is over aligned");
+            static_assert(!std::is_same_v<spill_t, no_spill>, "callable does not fit the inline storage and spilling is disabled");
+            static_assert(N >= sizeof(callable_tType*));
+            new (m_object) callable_tType*(spill<callable_tType>(std::forward<callable_t>(p_obj)));
+        }
+        m_ops = &ops<callable_tType>;
+    }
 
-        m_copier = [](void *p_obj, const void *p_other) {
-            new (p_obj) callable_tType(*(const callable_tType *)p_other);
-        };
+    void set(const std::nullptr_t)
+    {
+        m_ops = nullptr;
+    }
 
-        m_mover = [](void *p_obj, void *p_other) {
-            new (p_obj) callable_tType(std::move(*(callable_tType *)p_other));
-        };
+    void copy_from(const basic_function &p_other)
+    {
+        if (!p_other.m_ops)
+        {
+            return;
+        }
 
-        m_fn = [](const void *p_obj, args_t... pArgs) -> return_t {
-            return (*((callable_tType *)p_obj))(std::forward<args_t>(pArgs)...);
-        };
+        if (p_other.m_ops->copy)
+        {
+            p_other.m_ops->copy(m_object, p_other.m_object);
+        }
+        else
+        {
+            std::memcpy(m_object, p_other.m_object, N);
+        }
+        m_ops = p_other.m_ops;
     }
 
-    void set(const function &p_other)
+    void move_from(basic_function &p_other) noexcept
     {
-        m_fn = p_other.m_fn;
-        m_destroyer = p_other.m_destroyer;
-        m_copier = p_other.m_copier;
-        m_mover = p_other.m_mover;
+        if (!p_other.m_ops)
+        {
+            return;
+        }
+
+        if (p_other.m_ops->move)
+        {
+            p_other.m_ops->move(m_object, p_other.m_object);
+        }
+        else
+        {
+            std::memcpy(m_object, p_other.m_object, N);
+        }
+        m_ops = p_other.m_ops;
+        p_other.m_ops = nullptr;
     }
 
-    void set(const std::nullptr_t)
+    template <typename callable_tType, typename callable_t>
+    static callable_tType* spill(callable_t &&p_obj)
     {
-        clear();
+        void *block = spill_t::allocate(sizeof(callable_tType));
+        try
+        {
+            return new (block) callable_tType(std::forward<callable_t>(p_obj));
+        }
+        catch (...)
+        {
+            spill_t::deallocate(block, sizeof(callable_tType));
+            throw;
+        }
     }
 
-    void clear()
+    template <typename callable_tType>
+    static callable_tType* get(const void *p_obj)
     {
-        m_fn = nullptr;
+        if constexpr (is_inline<callable_tType>)
+        {
+            return (callable_tType *)p_obj;
+        }
+        else
+        {
+            return *(callable_tType *const *)p_obj;
+        }
     }
 
-    std::byte m_object[N];
-    return_t (*m_fn)(const void *, args_t...) = nullptr;
-    void (*m_destroyer)(void *) = nullptr;
-    void (*m_copier)(void *, const void *) = nullptr;
-    void (*m_mover)(void *, void *) = nullptr;
+    template <typename callable_tType>
+    static return_t invoke(const void *p_obj, args_t... pArgs)
+    {
+        return (*get<callable_tType>(p_obj))(std::forward<args_t>(pArgs)...);
+    }
+
+    template <typename callable_tType>
+    static void destroy(void *p_obj)
+    {
+        auto obj = get<callable_tType>(p_obj);
+        obj->~callable_tType();
+        if constexpr (!is_inline<callable_tType>)
+        {
+            spill_t::deallocate(obj, sizeof(callable_tType));
+        }
+    }
+
+    template <typename callable_tType>
+    static void copy(void *p_obj, const void *p_other)
+    {
+        if constexpr (is_inline<callable_tType>)
+        {
+            new (p_obj) callable_tType(*get<callable_tType>(p_other));
+        }
+        else
+        {
+            new (p_obj) callable_tType*(spill<callable_tType>(*get<callable_tType>(p_other)));
+        }
+    }
+
+    // Relocates the callable, the moved-from storage is left empty.
+    template <typename callable_tType>
+    static void move(void *p_obj, void *p_other)
+    {
+        auto other = get<callable_tType>(p_other);
+        new (p_obj) callable_tType(std::move(*other));
+        other->~callable_tType();
+    }
+
+    // Spilled callables only store a pointer and are always relocated by
+    // memcpy, trivial inline callables are copied by memcpy as well.
+    template <typename callable_tType>
+    static constexpr ops_t make_ops()
+    {
+        ops_t rv{&invoke<callable_tType>, nullptr, nullptr, nullptr};
+        if constexpr (!is_inline<callable_tType> || !is_trivial<callable_tType>)
+        {
+            rv.destroy = &destroy<callable_tType>;
+        }
+        if constexpr (COPYABLE && (!is_inline<callable_tType> || !is_trivial<callable_tType>))
+        {
+            rv.copy = &copy<callable_tType>;
+        }
+        if constexpr (is_inline<callable_tType> && !is_trivial<callable_tType>)
+        {
+            rv.move = &move<callable_tType>;
+        }
+        return rv;
+    }
+
+    template <typename callable_tType>
+    static constexpr ops_t ops = make_ops<callable_tType>();
+
+    alignas(alignment) std::byte m_object[N];
+    const ops_t *m_ops = nullptr;
 };
 
-template <size_t N, typename T>
-struct function_type_helper;
+// True for nullptr, null function pointers and empty function objects.
+template <typename T>
+bool is_null_callable(const T &p_obj)
+{
+    if constexpr (std::is_same_v<T, std::nullptr_t>)
+    {
+        return true;
+    }
+    else if constexpr (std::is_constructible_v<bool, const T &>)
+    {
+        return !p_obj;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Non-owning reference to a callable for callbacks that are only invoked
+// synchronously, the referenced callable must outlive the function_ref.
+template <typename T>
+class function_ref;
+template <typename return_t, typename... args_t>
+class function_ref<return_t(args_t...)>
+{
+public:
+    function_ref() = default;
+
+    function_ref(std::nullptr_t)
+    {}
+
+    template <typename callable_t, std::enable_if_t<!std::is_same_v<std::decay_t<callable_t>, function_ref> &&
+        std::is_invocable_r_v<return_t, callable_t&, args_t...>> *p = nullptr>
+    function_ref(callable_t &&p_obj)
+    {
+        using callable_tType = std::remove_reference_t<callable_t>;
+        using fn_ptr_t = std::decay_t<callable_t>;
+        if constexpr (std::is_pointer_v<fn_ptr_t> && std::is_function_v<std::remove_pointer_t<fn_ptr_t>>)
+        {
+            // Function pointers are stored by value, they are usually temporaries.
+            fn_ptr_t fn = p_obj;
+            if (!fn)
+            {
+                return;
+            }
+
+            m_object.fn = (void (*)())fn;
+            m_fn = [](object_t p_obj, args_t... pArgs) -> return_t {
+                return ((fn_ptr_t)p_obj.fn)(std::forward<args_t>(pArgs)...);
+            };
+        }
+        else
+        {
+            // Empty functions make an empty reference.
+            if (is_null_callable(p_obj))
+            {
+                return;
+            }
+
+            m_object.obj = (void *)std::addressof(p_obj);
+            m_fn = [](object_t p_obj, args_t... pArgs) -> return_t {
+                return (*(callable_tType *)p_obj.obj)(std::forward<args_t>(pArgs)...);
+            };
+        }
+    }
+
+    operator bool() const
+    {
+        return m_fn;
+    }
+
+    return_t operator()(args_t... pArgs) const
+    {
+        if (m_fn)
+        {
+            return m_fn(m_object, std::forward<args_t>(pArgs)...);
+        }
+        else
+        {
+            throw std::bad_function_call();
+        }
+    }
+
+private:
+    union object_t
+    {
+        void *obj;
+        void (*fn)();
+    };
+
+    object_t m_object = {nullptr};
+    return_t (*m_fn)(object_t, args_t...) = nullptr;
+};
+
+template <size_t N, typename return_t, typename... args_t>
+using function = basic_function<N, true, no_spill, return_t, args_t...>;
 template <size_t N, typename return_t, typename... args_t>
-struct function_type_helper<N, return_t(args_t...)>
+using unique_function = basic_function<N, false, no_spill, return_t, args_t...>;
+
+template <size_t N, typename T, typename spill_t = no_spill, bool COPYABLE = true>
+struct function_type_helper;
+template <size_t N, typename return_t, typename... args_t, typename spill_t, bool COPYABLE>
+struct function_type_helper<N, return_t(args_t...), spill_t, COPYABLE>
 {
-    using type = function<N, return_t, args_t...>;
+    using type = basic_function<N, COPYABLE, spill_t, return_t, args_t...>;
 };
 
-template <typename function_t>
-using ulight_function = typename function_type_helper<8, function_t>::type;
-template <typename function_t>
-using light_function = typename function_type_helper<24, function_t>::type;
-template <typename function_t>
-using big_function = typename function_type_helper<32, function_t>::type;
+template <typename function_t, typename spill_t = no_spill>
+using ulight_function = typename function_type_helper<8, function_t, spill_t>::type;
+template <typename function_t, typename spill_t = no_spill>
+using light_function = typename function_type_helper<24, function_t, spill_t>::type;
+template <typename function_t, typename spill_t = no_spill>
+using big_function = typename function_type_helper<32, function_t, spill_t>::type;
+
+template <typename function_t, typename spill_t = no_spill>
+using unique_ulight_function = typename function_type_helper<8, function_t, spill_t, false>::type;
+template <typename function_t, typename spill_t = no_spill>
+using unique_light_function = typename function_type_helper<24, function_t, spill_t, false>::type;
+template <typename function_t, typename spill_t = no_spill>
+using unique_big_function = typename function_type_helper<32, function_t, spill_t, false>::type;
 
 } // namespace bfc
 
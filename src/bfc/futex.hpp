@@ -0,0 +1,30 @@
+#ifndef __BFC_FUTEX_HPP__
+#define __BFC_FUTEX_HPP__
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace bfc
+{
+
+// Sleeps while p_word holds p_expected. Returns on a wake, a signal or a
+// spurious wake up, callers recheck their condition.
+inline void futex_wait(std::atomic<uint32_t>& p_word, uint32_t p_expected)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+    syscall(SYS_futex, (uint32_t*) &p_word, FUTEX_WAIT_PRIVATE, p_expected, nullptr, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>& p_word, int p_count = INT_MAX)
+{
+    syscall(SYS_futex, (uint32_t*) &p_word, FUTEX_WAKE_PRIVATE, p_count, nullptr, nullptr, 0);
+}
+
+} // namespace bfc
+
+#endif // __BFC_FUTEX_HPP__
@@ -0,0 +1,249 @@
+#ifndef __BFC_FUTURE_HPP__
+#define __BFC_FUTURE_HPP__
+
+#include <new>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <exception>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+#include <bfc/futex.hpp>
+#include <bfc/function.hpp>
+#include <bfc/memory_pool.hpp>
+#include <bfc/object_pool.hpp>
+
+namespace bfc
+{
+
+namespace detail
+{
+
+// State shared by a future and the task producing its result. States come
+// from a process wide object_pool per result type and are reference counted,
+// one reference for the future and one for the producer.
+template <typename T>
+class future_state
+{
+    struct empty_t
+    {};
+
+public:
+    using value_t = std::conditional_t<std::is_void_v<T>, empty_t, T>;
+    // Larger continuations spill to the process wide log2_memory_pool.
+    using continuation_t = typename function_type_helper<48, void(future_state*), log2_pool_spill<>, false>::type;
+
+    static future_state* create()
+    {
+        return pool().construct();
+    }
+
+    ~future_state()
+    {
+        if (m_has_value)
+        {
+            std::launder((value_t*) m_storage)->~value_t();
+        }
+    }
+
+    template <typename... args_t>
+    void set_value(args_t&&... p_args)
+    {
+        new (m_storage) value_t(std::forward<args_t>(p_args)...);
+        m_has_value = true;
+        complete();
+    }
+
+    void set_exception(std::exception_ptr p_error)
+    {
+        m_error = std::move(p_error);
+        complete();
+    }
+
+    // Runs p_fn, stores its result or exception and drops the producer's
+    // reference.
+    template <typename callable_t>
+    void run(callable_t& p_fn)
+    {
+        try
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                p_fn();
+                set_value();
+            }
+            else
+            {
+                set_value(p_fn());
+            }
+        }
+        catch (...)
+        {
+            set_exception(std::current_exception());
+        }
+        release();
+    }
+
+    bool is_ready() const
+    {
+        return m_flags.load(std::memory_order_acquire) & ready;
+    }
+
+    void wait()
+    {
+        auto flags = m_flags.load(std::memory_order_acquire);
+        while (!(flags & ready))
+        {
+            if (!(flags & waiting) && !m_flags.compare_exchange_weak(flags, flags | waiting, std::memory_order_acquire))
+            {
+                continue;
+            }
+            futex_wait(m_flags, flags | waiting);
+            flags = m_flags.load(std::memory_order_acquire);
+        }
+    }
+
+    // Throws the stored exception if there is one.
+    value_t& value()
+    {
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+        return *std::launder((value_t*) m_storage);
+    }
+
+    // p_continuation runs once the state is ready, right away if it already
+    // is, on whichever thread completes it.
+    void set_continuation(continuation_t p_continuation)
+    {
+        m_continuation = std::move(p_continuation);
+        if (m_flags.fetch_or(continued, std::memory_order_acq_rel) & ready)
+        {
+            m_continuation(this);
+        }
+    }
+
+    void release()
+    {
+        if (1 == m_refs.fetch_sub(1, std::memory_order_acq_rel))
+        {
+            pool().destroy(this);
+        }
+    }
+
+private:
+    static constexpr uint32_t ready = 1;
+    static constexpr uint32_t waiting = 2;
+    static constexpr uint32_t continued = 4;
+
+    static object_pool<future_state>& pool()
+    {
+        static object_pool<future_state> s_pool;
+        return s_pool;
+    }
+
+    void complete()
+    {
+        auto flags = m_flags.fetch_or(ready, std::memory_order_acq_rel);
+        if (flags & waiting)
+        {
+            futex_wake(m_flags);
+        }
+        if (flags & continued)
+        {
+            m_continuation(this);
+        }
+    }
+
+    std::atomic<uint32_t> m_flags{0};
+    std::atomic<uint32_t> m_refs{2};
+    bool m_has_value = false;
+    std::exception_ptr m_error;
+    alignas(value_t) std::byte m_storage[sizeof(value_t)];
+    continuation_t m_continuation;
+};
+
+template <typename T>
+struct future_release
+{
+    void operator()(future_state<T>* p_state) const
+    {
+        p_state->release();
+    }
+};
+
+} // namespace detail
+
+// Result of a task submitted to a pool. Unlike std::future the shared state
+// is a pooled block, waiting sleeps on a futex and a continuation can be
+// posted to a reactor instead of blocking on the result.
+template <typename T>
+class future
+{
+public:
+    using state_t = detail::future_state<T>;
+
+    future() = default;
+
+    // Adopts one reference of p_state.
+    explicit future(state_t* p_state)
+        : m_state(p_state)
+    {}
+
+    bool valid() const
+    {
+        return nullptr != m_state;
+    }
+
+    bool is_ready() const
+    {
+        return m_state->is_ready();
+    }
+
+    void wait() const
+    {
+        m_state->wait();
+    }
+
+    // Waits for the result and consumes it, the future is invalid afterwards.
+    // Rethrows what the task threw.
+    T get()
+    {
+        m_state->wait();
+        auto state = std::move(m_state);
+        if constexpr (std::is_void_v<T>)
+        {
+            state->value();
+        }
+        else
+        {
+            return std::move(state->value());
+        }
+    }
+
+    // Once the result is ready, p_cb(future<T>&&) runs on p_reactor's loop,
+    // posted through wake_up(). p_cb gets the ready future and calls get()
+    // on it. Consumes the future. A p_cb of up to 40 bytes is stored in the
+    // shared state, a larger one in a block of log2_pool_spill's pool; the
+    // reactor's own function type decides where the posted callback goes.
+    template <typename reactor_t, typename callable_t>
+    void then(reactor_t& p_reactor, callable_t&& p_cb) &&
+    {
+        auto state = m_state.release();
+        state->set_continuation([reactor = &p_reactor, cb = std::decay_t<callable_t>(std::forward<callable_t>(p_cb))](state_t* p_state) mutable {
+                reactor->wake_up([ready = future(p_state), cb = std::move(cb)]() mutable {
+                        cb(std::move(ready));
+                    });
+            });
+    }
+
+private:
+    std::unique_ptr<state_t, detail::future_release<T>> m_state;
+};
+
+} // namespace bfc
+
+#endif // __BFC_FUTURE_HPP__
@@ -0,0 +1,60 @@
+#ifndef __BFC_IDLE_POLICY_HPP__
+#define __BFC_IDLE_POLICY_HPP__
+
+#include <thread>
+#include <cstdint>
+
+namespace bfc
+{
+
+// Tells the core the thread is in a spin loop, so an SMT sibling gets the
+// execution resources and leaving the loop does not flush the pipeline.
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// How an idle consumer waits before it parks: spin rounds of cpu_relax(),
+// then yield rounds of std::this_thread::yield(), rechecking for work after
+// each. Parking costs a futex wake up and scheduler latency, spinning keeps
+// hand offs in the sub microsecond range while the system is busy at the
+// price of burning the core. Consumers only count as sleeping once they
+// park, so producers skip the notify while they spin. The default parks
+// right away.
+struct idle_policy
+{
+    uint32_t spin = 0;
+    uint32_t yield = 0;
+
+    // True as soon as p_ready() is, false when the caller should park.
+    template <typename predicate_t>
+    bool wait(predicate_t&& p_ready) const
+    {
+        for (uint32_t i=0; i<spin; i++)
+        {
+            if (p_ready())
+            {
+                return true;
+            }
+            cpu_relax();
+        }
+
+        for (uint32_t i=0; i<yield; i++)
+        {
+            if (p_ready())
+            {
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+};
+
+} // namespace bfc
+
+#endif // __BFC_IDLE_POLICY_HPP__
@@ -0,0 +1,51 @@
+#ifndef __BFC_LATCH_HPP__
+#define __BFC_LATCH_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+#include <bfc/futex.hpp>
+
+namespace bfc
+{
+
+// Single use countdown, waiters sleep on a futex until it reaches zero.
+class latch
+{
+public:
+    explicit latch(uint32_t p_count)
+        : m_count(p_count)
+    {}
+
+    latch(const latch&) = delete;
+    void operator=(const latch&) = delete;
+
+    void count_down(uint32_t p_count = 1)
+    {
+        if (p_count == m_count.fetch_sub(p_count, std::memory_order_acq_rel))
+        {
+            futex_wake(m_count);
+        }
+    }
+
+    bool try_wait() const
+    {
+        return 0 == m_count.load(std::memory_order_acquire);
+    }
+
+    void wait()
+    {
+        uint32_t count;
+        while (0 != (count = m_count.load(std::memory_order_acquire)))
+        {
+            futex_wait(m_count, count);
+        }
+    }
+
+private:
+    std::atomic<uint32_t> m_count;
+};
+
+} // namespace bfc
+
+#endif // __BFC_LATCH_HPP__
@@ -1,31 +1,536 @@
 #ifndef __BFC_MEMORYPOOL_HPP__
 #define __BFC_MEMORYPOOL_HPP__
 
+#include <sys/mman.h>
+#include <sys/unistd.h>
+
 #include <mutex>
 #include <array>
-#include <cmath>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include <string>
 #include <vector>
+#include <cstdio>
 #include <cstddef>
+#include <cstdint>
+#include <cinttypes>
+#include <stdexcept>
+#include <type_traits>
 
 #include <bfc/function.hpp>
 #include <bfc/buffer.hpp>
+#include <bfc/block_allocator.hpp>
 
 namespace bfc
 {
 
-template <size_t ALIGNMENT=alignof(std::max_align_t)>
+namespace detail
+{
+
+// Bounded per thread free list of a sized_memory_pool. Owned by the pool,
+// a thread keeps using the same magazine until it exits.
+struct alignas(64) pool_magazine
+{
+    static constexpr size_t capacity = 64;
+    std::byte* blocks[capacity];
+    size_t count = 0;
+    // Guarded by the owning pool's mutex.
+    bool attached = false;
+    // Only written by the attached thread, read by stats snapshots.
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> frees{0};
+
+    static void increment(std::atomic<uint64_t>& p_counter)
+    {
+        p_counter.store(p_counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+// Maps pool ids to live pools so compact handles can return their block
+// without carrying a deleter. Only holds trivially destructible state so
+// pools destroyed during static destruction can still unregister.
+class pool_registry
+{
+public:
+    // Ids are tagged as id + 1 in the uint16_t segment map, 0 being none.
+    static constexpr uint32_t capacity = UINT16_MAX;
+    using free_fn_t = void (*)(void*, const void*);
+    using detach_fn_t = void (*)(void*, pool_magazine*);
+
+    static uint32_t add(void* p_pool, free_fn_t p_free, detach_fn_t p_detach = nullptr)
+    {
+        std::unique_lock<std::mutex> lg(s_mtx);
+        uint32_t id;
+        if (npos != s_free_head)
+        {
+            id = s_free_head;
+            s_free_head = s_entries[id].next_free;
+        }
+        else if (s_next < capacity)
+        {
+            id = s_next++;
+        }
+        else
+        {
+            throw std::length_error("pool_registry full");
+        }
+
+        s_entries[id] = entry_t{p_pool, p_free, p_detach, ++s_generation, npos};
+        return id;
+    }
+
+    static void remove(uint32_t p_id)
+    {
+        std::unique_lock<std::mutex> lg(s_mtx);
+        s_entries[p_id] = entry_t{nullptr, nullptr, nullptr, 0, s_free_head};
+        s_free_head = p_id;
+    }
+
+    // Unique across pools that ever had this id, never 0.
+    static uint64_t generation(uint32_t p_id)
+    {
+        std::unique_lock<std::mutex> lg(s_mtx);
+        return s_entries[p_id].generation;
+    }
+
+    // Hands a magazine back to its pool if the pool is still alive, holding
+    // the registry lock so the pool cannot go away meanwhile.
+    static void detach(uint32_t p_id, uint64_t p_generation, pool_magazine* p_magazine)
+    {
+        std::unique_lock<std::mutex> lg(s_mtx);
+        auto& entry = s_entries[p_id];
+        if (entry.generation == p_generation && entry.detach)
+        {
+            entry.detach(entry.pool, p_magazine);
+        }
+    }
+
+    static void free(uint32_t p_id, const void* p_ptr)
+    {
+        auto& entry = s_entries[p_id];
+        entry.free(entry.pool, p_ptr);
+    }
+
+private:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    struct entry_t
+    {
+        void* pool;
+        free_fn_t free;
+        detach_fn_t detach;
+        uint64_t generation;
+        uint32_t next_free;
+    };
+
+    static inline std::mutex s_mtx;
+    static inline entry_t s_entries[capacity];
+    static inline uint32_t s_next = 0;
+    static inline uint32_t s_free_head = npos;
+    static inline uint64_t s_generation = 0;
+};
+
+// Thread local pool id to magazine map, detaches the magazines from their
+// pools when the thread exits.
+class magazine_cache
+{
+public:
+    struct entry_t
+    {
+        uint64_t generation = 0;
+        pool_magazine* magazine = nullptr;
+    };
+
+    // Null once the thread's cache is gone, e.g. for frees from other
+    // thread_local destructors.
+    static entry_t* get(uint32_t p_id)
+    {
+        if (t_exited)
+        {
+            return nullptr;
+        }
+
+        static thread_local magazine_cache cache;
+        auto& entries = cache.m_entries;
+        if (p_id >= entries.size())
+        {
+            entries.resize(p_id + 1);
+        }
+        return &entries[p_id];
+    }
+
+    ~magazine_cache()
+    {
+        t_exited = true;
+        for (uint32_t i = 0; i < m_entries.size(); i++)
+        {
+            if (m_entries[i].magazine)
+            {
+                pool_registry::detach(i, m_entries[i].generation, m_entries[i].magazine);
+            }
+        }
+    }
+
+private:
+    std::vector<entry_t> m_entries;
+    static inline thread_local bool t_exited = false;
+};
+
+// Process wide map from 4 KiB address segments to the registry id of the
+// pool owning them, so a block can be freed without knowing its size. Two
+// levels over a 48 bit address space, the leaves are created on demand and
+// never freed so lookups need no lock. Segments are page sized so a size
+// class only pins a page per slab and a mapping never shares a segment with
+// a neighbouring one; a leaf covers 1 GiB in 512 KiB of anonymous memory
+// whose pages are only committed once a tag is stored in them.
+class segment_map
+{
+public:
+    static constexpr size_t segment_shift = 12;
+    static constexpr size_t segment_size = size_t(1) << segment_shift;
+    static constexpr uint16_t none = 0;
+
+    // Tags every segment overlapping [p_base, p_base+p_size), p_tag is a
+    // registry id plus one or none to clear.
+    static void set(const void* p_base, size_t p_size, uint16_t p_tag)
+    {
+        auto first = uintptr_t(p_base) >> segment_shift;
+        auto last = (uintptr_t(p_base) + p_size - 1) >> segment_shift;
+        for (auto segment = first; segment <= last; segment++)
+        {
+            auto leaf = s_root[root_index(segment)].load(std::memory_order_acquire);
+            if (!leaf)
+            {
+                leaf = create_leaf(root_index(segment));
+            }
+            leaf[segment & leaf_mask].store(p_tag, std::memory_order_release);
+        }
+    }
+
+    static uint16_t get(const void* p_ptr)
+    {
+        auto segment = uintptr_t(p_ptr) >> segment_shift;
+        if (root_index(segment) >= root_size)
+        {
+            return none;
+        }
+        auto leaf = s_root[root_index(segment)].load(std::memory_order_acquire);
+        return leaf ? leaf[segment & leaf_mask].load(std::memory_order_acquire) : none;
+    }
+
+private:
+    static constexpr size_t leaf_bits = 18;
+    static constexpr size_t leaf_mask = (size_t(1) << leaf_bits) - 1;
+    static constexpr size_t root_size = size_t(1) << (48 - segment_shift - leaf_bits);
+
+    static size_t root_index(uintptr_t p_segment)
+    {
+        return p_segment >> leaf_bits;
+    }
+
+    static std::atomic<uint16_t>* create_leaf(size_t p_index)
+    {
+        if (p_index >= root_size)
+        {
+            throw std::bad_alloc();
+        }
+
+        std::unique_lock<std::mutex> lg(s_mtx);
+        auto leaf = s_root[p_index].load(std::memory_order_acquire);
+        if (!leaf)
+        {
+            // Anonymous pages read as zero, which is none, and are only
+            // committed once a tag is stored.
+            auto size = sizeof(std::atomic<uint16_t>) << leaf_bits;
+            auto pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (MAP_FAILED == pages)
+            {
+                throw std::bad_alloc();
+            }
+            leaf = (std::atomic<uint16_t>*) pages;
+            s_root[p_index].store(leaf, std::memory_order_release);
+        }
+        return leaf;
+    }
+
+    static inline std::atomic<std::atomic<uint16_t>*> s_root[root_size];
+    static inline std::mutex s_mtx;
+};
+
+// Smallest slab worth carving for an allocator, allocators that hand out
+// whole segments declare it with a static slab_granularity.
+template <typename T, typename = void>
+struct slab_granularity : std::integral_constant<size_t, 1>
+{};
+
+template <typename T>
+struct slab_granularity<T, std::void_t<decltype(T::slab_granularity)>>
+    : std::integral_constant<size_t, T::slab_granularity>
+{};
+
+// Wraps a block allocator so every slab covers whole segments and is tagged
+// in the segment_map with the owning pool. Slabs are segment aligned, so the
+// first slab of every size class costs at least one 4 KiB segment.
+template <typename allocator_t>
+class segment_allocator
+{
+public:
+    static constexpr size_t slab_granularity = segment_map::segment_size;
+
+    segment_allocator(allocator_t p_allocator)
+        : m_allocator(std::move(p_allocator))
+    {}
+
+    void tag(uint32_t p_pool_id)
+    {
+        m_tag = p_pool_id + 1;
+    }
+
+    std::byte* allocate(size_t p_size, size_t p_alignment)
+    {
+        auto size = round_up(p_size);
+        auto rv = m_allocator.allocate(size, std::max(p_alignment, slab_granularity));
+        segment_map::set(rv, size, m_tag);
+        return rv;
+    }
+
+    void deallocate(std::byte* p_ptr, size_t p_size, size_t p_alignment)
+    {
+        auto size = round_up(p_size);
+        segment_map::set(p_ptr, size, segment_map::none);
+        m_allocator.deallocate(p_ptr, size, std::max(p_alignment, slab_granularity));
+    }
+
+private:
+    static size_t round_up(size_t p_size)
+    {
+        return (p_size + slab_granularity - 1) & ~(slab_granularity - 1);
+    }
+
+    allocator_t m_allocator;
+    uint16_t m_tag = segment_map::none;
+};
+
+// Allocations too large for any size class get their own mapping, with the
+// mapping length stored in front of the returned block.
+template <size_t ALIGNMENT>
+class large_allocation
+{
+public:
+    static constexpr size_t header_size = std::max(ALIGNMENT, sizeof(size_t));
+
+    static std::byte* allocate(size_t p_size)
+    {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t length = (p_size + header_size + page - 1) / page * page;
+        void* base = mmap(nullptr, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == base)
+        {
+            throw std::bad_alloc();
+        }
+
+        *(size_t*) base = length;
+        segment_map::set(base, length, id() + 1);
+        return (std::byte*) base + header_size;
+    }
+
+    // Clears the tags of the segments the mapping covers whole first, the
+    // range may be mapped again by anyone. That is all of them unless pages
+    // are smaller than segments.
+    static void free(const void* p_ptr)
+    {
+        auto base = (std::byte*) p_ptr - header_size;
+        auto length = *(size_t*) base;
+        auto mask = segment_map::segment_size - 1;
+        auto first = (uintptr_t(base) + mask) & ~mask;
+        auto last = (uintptr_t(base) + length) & ~mask;
+        if (first < last)
+        {
+            segment_map::set((void*) first, last - first, segment_map::none);
+        }
+        munmap(base, length);
+    }
+
+    static uint32_t id()
+    {
+        static const uint32_t rv = pool_registry::add(nullptr, [](void*, const void* p_ptr){
+                free(p_ptr);
+            });
+        return rv;
+    }
+};
+
+} // namespace detail
+
+// Pool block handle of 16 bytes: the block pointer, its size and the id of
+// the owning pool, which is looked up in the pool registry on release. The
+// pool must outlive the handle.
+class pooled_buffer
+{
+public:
+    pooled_buffer() = default;
+
+    pooled_buffer(std::byte* p_data, uint32_t p_size, uint32_t p_pool_id)
+        : m_data(p_data)
+        , m_size(p_size)
+        , m_pool_id(p_pool_id)
+    {}
+
+    pooled_buffer(const pooled_buffer&) = delete;
+    void operator=(const pooled_buffer&) = delete;
+
+    pooled_buffer(pooled_buffer&& p_other) noexcept
+        : m_data(p_other.m_data)
+        , m_size(p_other.m_size)
+        , m_pool_id(p_other.m_pool_id)
+    {
+        p_other.clear();
+    }
+
+    pooled_buffer& operator=(pooled_buffer&& p_other) noexcept
+    {
+        if (this != &p_other)
+        {
+            reset();
+            m_data = p_other.m_data;
+            m_size = p_other.m_size;
+            m_pool_id = p_other.m_pool_id;
+            p_other.clear();
+        }
+        return *this;
+    }
+
+    ~pooled_buffer()
+    {
+        reset();
+    }
+
+    std::byte* data() const
+    {
+        return m_data;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    uint32_t pool_id() const
+    {
+        return m_pool_id;
+    }
+
+    void reset() noexcept
+    {
+        if (m_data)
+        {
+            detail::pool_registry::free(m_pool_id, m_data);
+        }
+        clear();
+    }
+
+private:
+    void clear() noexcept
+    {
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    std::byte* m_data = nullptr;
+    uint32_t m_size = 0;
+    uint32_t m_pool_id = 0;
+};
+
+// Snapshot of a pool's counters, misses count the slabs carved because the
+// pool ran out of blocks.
+struct memory_pool_stats
+{
+    size_t block_size;
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t misses;
+    size_t outstanding_bytes;
+    size_t retained_bytes;
+    size_t high_water_bytes;
+};
+
+inline std::string to_string(const memory_pool_stats& p_stats)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "block_size: %zu allocations: %" PRIu64 " frees: %" PRIu64 " misses: %" PRIu64
+        " outstanding_bytes: %zu retained_bytes: %zu high_water_bytes: %zu\n",
+        p_stats.block_size, p_stats.allocations, p_stats.frees, p_stats.misses,
+        p_stats.outstanding_bytes, p_stats.retained_bytes, p_stats.high_water_bytes);
+    return line;
+}
+
+// One line per size class that was ever used, e.g. for a command_manager
+// command dumping a log2_memory_pool.
+inline std::string to_string(const std::vector<memory_pool_stats>& p_stats)
+{
+    std::string rv;
+    for (auto& stats : p_stats)
+    {
+        if (stats.allocations || stats.retained_bytes)
+        {
+            rv += to_string(stats);
+        }
+    }
+    return rv;
+}
+
+// Fixed size block pool. Each thread allocates from and frees to its own
+// magazine of up to p_thread_cache blocks, exchanging half a magazine with
+// the shared depot under the mutex when it runs empty or full. A
+// p_thread_cache of 0 makes every call go to the depot.
+//
+// Blocks are carved from slabs taken from the allocator, starting with a
+// single block and doubling up to p_slab_size bytes. When the depot holds
+// more than p_max_retained blocks, slabs whose blocks are all back in the
+// depot are returned to the allocator.
+//
+// Every live pool holds one of the 65535 process wide registry ids, the
+// constructor throws std::length_error once they are all taken.
+template <size_t ALIGNMENT=alignof(std::max_align_t), typename allocator_t = heap_block_allocator>
 class sized_memory_pool
 {
 public:
-    sized_memory_pool(size_t p_size)
+    static constexpr size_t default_thread_cache = 32;
+    static constexpr size_t default_slab_size = 64*1024;
+    static constexpr size_t unlimited = SIZE_MAX;
+
+    sized_memory_pool(size_t p_size, allocator_t p_allocator = {}, size_t p_thread_cache = default_thread_cache,
+        size_t p_slab_size = default_slab_size, size_t p_max_retained = unlimited)
         : m_size(p_size)
+        , m_stride((std::max(p_size, size_t(1)) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)
+        , m_slab_blocks(std::max(p_slab_size / m_stride, size_t(1)))
+        , m_max_retained(p_max_retained)
+        , m_trim_at(p_max_retained)
+        , m_allocator(std::move(p_allocator))
+        , m_thread_cache(std::min(p_thread_cache, detail::pool_magazine::capacity))
+        , m_id(detail::pool_registry::add(this,
+            [](void* p_pool, const void* p_ptr){
+                ((sized_memory_pool*) p_pool)->free(p_ptr);
+            },
+            [](void* p_pool, detail::pool_magazine* p_magazine){
+                ((sized_memory_pool*) p_pool)->detach(*p_magazine);
+            }))
+        , m_generation(detail::pool_registry::generation(m_id))
     {}
 
+    sized_memory_pool(const sized_memory_pool&) = delete;
+    void operator=(const sized_memory_pool&) = delete;
+
+    // Other threads must be done with the pool, all blocks are released with
+    // their slabs.
     ~sized_memory_pool()
     {
-        for (auto i : m_allocations)
+        detail::pool_registry::remove(m_id);
+        for (auto& slab : m_slabs)
         {
-            operator delete[](i, std::align_val_t {ALIGNMENT});
+            m_allocator.deallocate(slab.base, slab.blocks * m_stride, ALIGNMENT);
         }
     }
 
@@ -35,10 +540,89 @@ public:
         return buffer(rv, m_size, [this](const void* p_ptr){free(p_ptr);});
     }
 
+    pooled_buffer allocate_pooled()
+    {
+        if (m_size > UINT32_MAX)
+        {
+            throw std::length_error("sized_memory_pool too large for pooled_buffer");
+        }
+        return pooled_buffer(allocate_raw(), m_size, m_id);
+    }
+
     void free(const void* p_ptr)
+    {
+        auto mag_ptr = magazine();
+        if (!mag_ptr)
+        {
+            std::unique_lock<std::mutex> lg(m_alloc_mtx);
+            m_allocations.emplace_back((std::byte*)(p_ptr));
+            m_shared_frees++;
+            trim_if_needed();
+            return;
+        }
+
+        auto& mag = *mag_ptr;
+        detail::pool_magazine::increment(mag.frees);
+        if (mag.count == m_thread_cache)
+        {
+            std::unique_lock<std::mutex> lg(m_alloc_mtx);
+            auto batch = (m_thread_cache + 1) / 2;
+            mag.count -= batch;
+            m_allocations.insert(m_allocations.end(), mag.blocks + mag.count, mag.blocks + mag.count + batch);
+            trim_if_needed();
+        }
+        mag.blocks[mag.count++] = (std::byte*)(p_ptr);
+    }
+
+    // Carves one slab so the depot holds at least p_count blocks, meant to
+    // be called at startup so the first burst does not hit the allocator.
+    void reserve(size_t p_count)
+    {
+        std::unique_lock<std::mutex> lg(m_alloc_mtx);
+        if (m_allocations.size() < p_count)
+        {
+            carve(p_count - m_allocations.size());
+        }
+    }
+
+    // Returns every slab whose blocks are all in the depot to the allocator.
+    // Blocks cached by threads keep their slabs alive.
+    void trim()
     {
         std::unique_lock<std::mutex> lg(m_alloc_mtx);
-        m_allocations.emplace_back((std::byte*)(p_ptr));
+        trim_to(0);
+    }
+
+    // Number of blocks carved from the allocator and not yet trimmed.
+    size_t capacity()
+    {
+        std::unique_lock<std::mutex> lg(m_alloc_mtx);
+        return m_capacity;
+    }
+
+    // Sums the per thread counters, which may be slightly behind for
+    // threads allocating concurrently. Bytes are counted in whole blocks
+    // including alignment padding, the high water mark counts blocks held
+    // by thread caches as in use.
+    memory_pool_stats stats()
+    {
+        std::unique_lock<std::mutex> lg(m_alloc_mtx);
+        memory_pool_stats rv{};
+        rv.block_size = m_size;
+        rv.allocations = m_shared_allocations;
+        rv.frees = m_shared_frees;
+        for (auto& magazine : m_magazines)
+        {
+            rv.allocations += magazine->allocations.load(std::memory_order_relaxed);
+            rv.frees += magazine->frees.load(std::memory_order_relaxed);
+        }
+        rv.misses = m_misses;
+
+        size_t outstanding = rv.allocations > rv.frees ? std::min<uint64_t>(rv.allocations - rv.frees, m_capacity) : 0;
+        rv.outstanding_bytes = outstanding * m_stride;
+        rv.retained_bytes = (m_capacity - outstanding) * m_stride;
+        rv.high_water_bytes = std::max(m_high_water, outstanding) * m_stride;
+        return rv;
     }
 
     size_t size() const
@@ -46,70 +630,441 @@ public:
         return m_size;
     }
 
-private:
+    uint32_t id() const
+    {
+        return m_id;
+    }
+
+    allocator_t& allocator()
+    {
+        return m_allocator;
+    }
+
     std::byte* allocate_raw()
     {
-        std::byte* rv;
+        auto mag_ptr = magazine();
+        if (!mag_ptr)
+        {
+            return allocate_shared();
+        }
+
+        auto& mag = *mag_ptr;
+        if (mag.count)
+        {
+            detail::pool_magazine::increment(mag.allocations);
+            return mag.blocks[--mag.count];
+        }
+
         std::unique_lock<std::mutex> lg(m_alloc_mtx);
-        if (m_allocations.size())
+        if (m_allocations.empty())
         {
-            rv = m_allocations.back();
-            m_allocations.pop_back();
-            lg.unlock();
+            grow();
         }
-        else
+
+        // Only counted once a block was obtained, grow() may throw.
+        detail::pool_magazine::increment(mag.allocations);
+        auto batch = std::min((m_thread_cache + 1) / 2, m_allocations.size());
+        auto first = m_allocations.end() - batch;
+        std::copy(first, m_allocations.end(), mag.blocks);
+        m_allocations.erase(first, m_allocations.end());
+        update_high_water();
+        mag.count = batch;
+        return mag.blocks[--mag.count];
+    }
+
+private:
+    std::byte* allocate_shared()
+    {
+        std::unique_lock<std::mutex> lg(m_alloc_mtx);
+        if (m_allocations.empty())
         {
-            rv = (std::byte*) operator new[](m_size, std::align_val_t {ALIGNMENT});
+            grow();
         }
+        auto rv = m_allocations.back();
+        m_allocations.pop_back();
+        m_shared_allocations++;
+        update_high_water();
         return rv;
     }
 
+    void update_high_water()
+    {
+        m_high_water = std::max(m_high_water, m_capacity - m_allocations.size());
+    }
+
+    struct slab_t
+    {
+        std::byte* base;
+        size_t blocks;
+    };
+
+    // Called with the depot empty and locked.
+    void grow()
+    {
+        m_misses++;
+        carve(m_next_slab_blocks);
+        m_next_slab_blocks = std::min(m_next_slab_blocks * 2, m_slab_blocks);
+        m_trim_at = m_max_retained;
+    }
+
+    // Pushes the blocks highest address first so they are handed out in
+    // address order.
+    void carve(size_t p_blocks)
+    {
+        auto base = m_allocator.allocate(p_blocks * m_stride, ALIGNMENT);
+        auto slab = std::upper_bound(m_slabs.begin(), m_slabs.end(), base,
+            [](std::byte* p_base, const slab_t& p_slab){ return p_base < p_slab.base; });
+        m_slabs.insert(slab, slab_t{base, p_blocks});
+        m_capacity += p_blocks;
+
+        m_allocations.reserve(m_allocations.size() + p_blocks);
+        for (size_t i = p_blocks; i > 0; i--)
+        {
+            m_allocations.emplace_back(base + (i - 1) * m_stride);
+        }
+    }
+
+    void trim_if_needed()
+    {
+        if (m_allocations.size() > m_trim_at)
+        {
+            trim_to(m_max_retained);
+            // Whatever is left is held by partially used slabs, do not rescan
+            // on every free until another slab worth of blocks came back.
+            m_trim_at = std::max(m_max_retained, m_allocations.size()) + m_slab_blocks;
+        }
+    }
+
+    // Releases fully free slabs until the depot holds at most p_keep blocks.
+    // Both the depot and the slabs are sorted by address so each block is
+    // matched to its slab in one pass.
+    void trim_to(size_t p_keep)
+    {
+        std::sort(m_allocations.begin(), m_allocations.end());
+
+        std::vector<size_t> free_blocks(m_slabs.size());
+        size_t slab = 0;
+        for (auto block : m_allocations)
+        {
+            while (block >= m_slabs[slab].base + m_slabs[slab].blocks * m_stride)
+            {
+                slab++;
+            }
+            free_blocks[slab]++;
+        }
+
+        auto retained = m_allocations.size();
+        std::vector<bool> release(m_slabs.size());
+        for (size_t i = 0; i < m_slabs.size() && retained > p_keep; i++)
+        {
+            if (free_blocks[i] == m_slabs[i].blocks)
+            {
+                release[i] = true;
+                retained -= m_slabs[i].blocks;
+            }
+        }
+
+        slab = 0;
+        auto last = std::remove_if(m_allocations.begin(), m_allocations.end(), [&](std::byte* p_block) {
+                while (p_block >= m_slabs[slab].base + m_slabs[slab].blocks * m_stride)
+                {
+                    slab++;
+                }
+                return release[slab];
+            });
+        m_allocations.erase(last, m_allocations.end());
+        // Keep handing out the lowest addresses first.
+        std::reverse(m_allocations.begin(), m_allocations.end());
+
+        size_t kept = 0;
+        for (size_t i = 0; i < m_slabs.size(); i++)
+        {
+            if (release[i])
+            {
+                m_capacity -= m_slabs[i].blocks;
+                m_allocator.deallocate(m_slabs[i].base, m_slabs[i].blocks * m_stride, ALIGNMENT);
+            }
+            else
+            {
+                m_slabs[kept++] = m_slabs[i];
+            }
+        }
+        m_slabs.resize(kept);
+    }
+
+    // Null when thread caching is off or the thread is exiting.
+    detail::pool_magazine* magazine()
+    {
+        if (!m_thread_cache)
+        {
+            return nullptr;
+        }
+
+        auto entry = detail::magazine_cache::get(m_id);
+        if (!entry)
+        {
+            return nullptr;
+        }
+
+        if (entry->generation != m_generation)
+        {
+            entry->magazine = attach();
+            entry->generation = m_generation;
+        }
+        return entry->magazine;
+    }
+
+    // Reuses a magazine left behind by an exited thread when there is one.
+    detail::pool_magazine* attach()
+    {
+        std::unique_lock<std::mutex> lg(m_alloc_mtx);
+        for (auto& magazine : m_magazines)
+        {
+            if (!magazine->attached)
+            {
+                magazine->attached = true;
+                return magazine.get();
+            }
+        }
+
+        m_magazines.emplace_back(std::make_unique<detail::pool_magazine>());
+        m_magazines.back()->attached = true;
+        return m_magazines.back().get();
+    }
+
+    void detach(detail::pool_magazine& p_magazine)
+    {
+        std::unique_lock<std::mutex> lg(m_alloc_mtx);
+        m_allocations.insert(m_allocations.end(), p_magazine.blocks, p_magazine.blocks + p_magazine.count);
+        p_magazine.count = 0;
+        p_magazine.attached = false;
+        trim_if_needed();
+    }
+
     const size_t m_size;
+    const size_t m_stride;
+    const size_t m_slab_blocks;
+    const size_t m_max_retained;
+    size_t m_trim_at;
+    size_t m_next_slab_blocks = std::min(std::max(detail::slab_granularity<allocator_t>::value / m_stride, size_t(1)), m_slab_blocks);
+    allocator_t m_allocator;
+    const size_t m_thread_cache;
+    const uint32_t m_id;
+    const uint64_t m_generation;
     std::vector<std::byte*> m_allocations;
+    std::vector<slab_t> m_slabs;
+    size_t m_capacity = 0;
+    size_t m_high_water = 0;
+    uint64_t m_misses = 0;
+    // Counters of the locked path, threads with a magazine count in it.
+    uint64_t m_shared_allocations = 0;
+    uint64_t m_shared_frees = 0;
+    std::vector<std::unique_ptr<detail::pool_magazine>> m_magazines;
     std::mutex m_alloc_mtx;
 };
 
-template <size_t ALIGNMENT = alignof(std::max_align_t)>
+// Size class pool from 16 bytes up to 16 KiB. Every power of two range is
+// split into SUB_CLASSES evenly spaced classes, e.g. 4 gives 40, 48, 56 and
+// 64 for sizes above 32, the default of 1 keeps plain powers of two. Larger
+// sizes are mapped directly. Class sizes are rounded up to ALIGNMENT by the
+// class pools, so sub classes only pay off when they are multiples of it.
+// Each class pool holds a registry id, so a log2 pool takes class_count of
+// the 65535 process wide ids, e.g. 11 with the default SUB_CLASSES.
+template <size_t ALIGNMENT = alignof(std::max_align_t), typename allocator_t = heap_block_allocator, size_t SUB_CLASSES = 1>
 class log2_memory_pool
 {
+    static_assert(SUB_CLASSES && SUB_CLASSES <= 16 && !(SUB_CLASSES & (SUB_CLASSES - 1)),
+        "SUB_CLASSES must be a power of two up to 16");
+    static_assert(ALIGNMENT <= detail::segment_map::segment_size);
+
 public:
+    static constexpr size_t min_size = 16;
+    static constexpr size_t max_size = 16384;
+    static constexpr size_t class_count = 1 + (14 - 4) * SUB_CLASSES;
+
+    // Every size class gets a copy of p_allocator.
+    log2_memory_pool(allocator_t p_allocator = {}, size_t p_thread_cache = pool_t::default_thread_cache)
+        : log2_memory_pool(p_allocator, p_thread_cache, std::make_index_sequence<class_count>())
+    {}
+
     buffer allocate(size_t p_size)
     {
-        if (p_size<=8)
+        if (p_size > max_size)
         {
-            throw std::bad_alloc();
+            return buffer(large_t::allocate(p_size), p_size, [](const void* p_ptr){large_t::free(p_ptr);});
         }
-        int index = std::ceil(std::log2(p_size))-4;
-        return m_pools.at(index).allocate();
+        return m_pools[index(p_size)].allocate();
     }
 
-    void free(const std::byte* p_alloc, size_t p_size)
+    pooled_buffer allocate_pooled(size_t p_size)
     {
-        if (p_size<=8)
+        if (p_size > max_size)
         {
-            throw std::bad_alloc();
+            if (p_size > UINT32_MAX)
+            {
+                throw std::length_error("allocation too large for pooled_buffer");
+            }
+            return pooled_buffer(large_t::allocate(p_size), p_size, large_t::id());
+        }
+        return m_pools[index(p_size)].allocate_pooled();
+    }
+
+    std::byte* allocate_raw(size_t p_size)
+    {
+        if (p_size > max_size)
+        {
+            return large_t::allocate(p_size);
+        }
+        return m_pools[index(p_size)].allocate_raw();
+    }
+
+    void free(const void* p_alloc, size_t p_size)
+    {
+        if (p_size > max_size)
+        {
+            return large_t::free(p_alloc);
+        }
+        m_pools[index(p_size)].free(p_alloc);
+    }
+
+    // Finds the owning pool from the block's address.
+    void free(const void* p_alloc)
+    {
+        auto tag = detail::segment_map::get(p_alloc);
+        if (detail::segment_map::none == tag)
+        {
+            throw std::invalid_argument("log2_memory_pool::free unknown block");
+        }
+        detail::pool_registry::free(tag - 1, p_alloc);
+    }
+
+    // One entry per size class, large mappings are not tracked.
+    std::vector<memory_pool_stats> stats()
+    {
+        std::vector<memory_pool_stats> rv;
+        rv.reserve(class_count);
+        for (auto& pool : m_pools)
+        {
+            rv.emplace_back(pool.stats());
+        }
+        return rv;
+    }
+
+    // Size of the block handed out for p_size.
+    static constexpr size_t class_size(size_t p_size)
+    {
+        return p_size > max_size ? p_size : s_class_sizes[index(p_size)];
+    }
+
+    static constexpr size_t index(size_t p_size)
+    {
+        if (p_size <= min_size)
+        {
+            return 0;
         }
-        int index = std::ceil(std::log2(p_size))-4;
-        return m_pools.at(index).free(p_alloc);
+
+        // p_size-1 lies in [2^k, 2^(k+1)), its bits below the leading one
+        // select the sub class.
+        size_t k = 63 - __builtin_clzll(p_size - 1);
+        size_t sub = ((p_size - 1) >> (k - sub_shift)) - SUB_CLASSES;
+        return 1 + ((k - 4) << sub_shift) + sub;
     }
 
 private:
-    using pool_t = sized_memory_pool<ALIGNMENT>;
-    std::array<pool_t,11> m_pools = {
-        pool_t(16),
-        pool_t(32),
-        pool_t(64),
-        pool_t(128),
-        pool_t(256),
-        pool_t(512),
-        pool_t(1024),
-        pool_t(2048),
-        pool_t(4096),
-        pool_t(8192),
-        pool_t(16384)
-    };
+    using pool_t = sized_memory_pool<ALIGNMENT, detail::segment_allocator<allocator_t>>;
+    using large_t = detail::large_allocation<ALIGNMENT>;
+
+    static constexpr size_t sub_shift = __builtin_ctzll(SUB_CLASSES);
+
+    static constexpr std::array<size_t, class_count> make_class_sizes()
+    {
+        std::array<size_t, class_count> rv{};
+        rv[0] = min_size;
+        for (size_t i = 1; i < class_count; i++)
+        {
+            size_t k = 4 + (i - 1) / SUB_CLASSES;
+            size_t sub = (i - 1) % SUB_CLASSES;
+            rv[i] = (size_t(1) << k) + ((sub + 1) << (k - sub_shift));
+        }
+        return rv;
+    }
+
+    static constexpr std::array<size_t, class_count> s_class_sizes = make_class_sizes();
+
+    template <size_t... I>
+    log2_memory_pool(allocator_t& p_allocator, size_t p_thread_cache, std::index_sequence<I...>)
+        : m_pools{pool_t(s_class_sizes[I], p_allocator, p_thread_cache)...}
+    {
+        for (auto& pool : m_pools)
+        {
+            pool.allocator().tag(pool.id());
+        }
+    }
+
+    std::array<pool_t, class_count> m_pools;
 };
 
+// Spill policies for bfc::basic_function, oversized callables are placed in a
+// block of a process wide pool. The pools are intentionally never destroyed so
+// functions with static storage duration can still release their blocks.
+template <size_t ALIGNMENT = alignof(std::max_align_t)>
+struct log2_pool_spill
+{
+    static log2_memory_pool<ALIGNMENT>& pool()
+    {
+        static auto rv = new log2_memory_pool<ALIGNMENT>();
+        return *rv;
+    }
+
+    static void* allocate(size_t p_size)
+    {
+        return pool().allocate_raw(p_size);
+    }
+
+    static void deallocate(void* p_ptr, size_t p_size)
+    {
+        pool().free((const std::byte*) p_ptr, p_size);
+    }
+};
+
+template <size_t SIZE, size_t ALIGNMENT = alignof(std::max_align_t)>
+struct sized_pool_spill
+{
+    static sized_memory_pool<ALIGNMENT>& pool()
+    {
+        static auto rv = new sized_memory_pool<ALIGNMENT>(SIZE);
+        return *rv;
+    }
+
+    static void* allocate(size_t p_size)
+    {
+        if (p_size > SIZE)
+        {
+            throw std::bad_alloc();
+        }
+        return pool().allocate_raw();
+    }
+
+    static void deallocate(void* p_ptr, size_t)
+    {
+        pool().free(p_ptr);
+    }
+};
+
+template <typename function_t>
+using spill_ulight_function = ulight_function<function_t, log2_pool_spill<>>;
+template <typename function_t>
+using spill_light_function = light_function<function_t, log2_pool_spill<>>;
+template <typename function_t>
+using spill_big_function = big_function<function_t, log2_pool_spill<>>;
+
+template <typename function_t>
+using spill_unique_ulight_function = unique_ulight_function<function_t, log2_pool_spill<>>;
+template <typename function_t>
+using spill_unique_light_function = unique_light_function<function_t, log2_pool_spill<>>;
+template <typename function_t>
+using spill_unique_big_function = unique_big_function<function_t, log2_pool_spill<>>;
+
 } // namespace bfc
 
 #endif // __BFC_MEMORYPOOL_HPP__
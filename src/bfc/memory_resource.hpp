@@ -0,0 +1,281 @@
+#ifndef __BFC_MEMORY_RESOURCE_HPP__
+#define __BFC_MEMORY_RESOURCE_HPP__
+
+#include <memory_resource>
+#include <algorithm>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <bfc/memory_pool.hpp>
+
+namespace bfc
+{
+
+// std::pmr::memory_resource views over the pools so standard and BFC
+// containers can allocate from them through std::pmr::polymorphic_allocator.
+// The resources do not own their pool, requests a pool cannot serve go to
+// the upstream resource.
+
+template <size_t ALIGNMENT = alignof(std::max_align_t), typename allocator_t = heap_block_allocator, size_t SUB_CLASSES = 1>
+class log2_pool_resource : public std::pmr::memory_resource
+{
+public:
+    using pool_t = log2_memory_pool<ALIGNMENT, allocator_t, SUB_CLASSES>;
+
+    log2_pool_resource(pool_t& p_pool, std::pmr::memory_resource* p_upstream = std::pmr::new_delete_resource())
+        : m_pool(p_pool)
+        , m_upstream(p_upstream)
+    {}
+
+    pool_t& pool()
+    {
+        return m_pool;
+    }
+
+private:
+    void* do_allocate(size_t p_bytes, size_t p_alignment) override
+    {
+        if (p_alignment > ALIGNMENT)
+        {
+            return m_upstream->allocate(p_bytes, p_alignment);
+        }
+        return m_pool.allocate_raw(p_bytes);
+    }
+
+    void do_deallocate(void* p_ptr, size_t p_bytes, size_t p_alignment) override
+    {
+        if (p_alignment > ALIGNMENT)
+        {
+            return m_upstream->deallocate(p_ptr, p_bytes, p_alignment);
+        }
+        m_pool.free(p_ptr, p_bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& p_other) const noexcept override
+    {
+        return this == &p_other;
+    }
+
+    pool_t& m_pool;
+    std::pmr::memory_resource* m_upstream;
+};
+
+// Meant for node based containers whose nodes fit the pool's block size.
+template <size_t ALIGNMENT = alignof(std::max_align_t), typename allocator_t = heap_block_allocator>
+class sized_pool_resource : public std::pmr::memory_resource
+{
+public:
+    using pool_t = sized_memory_pool<ALIGNMENT, allocator_t>;
+
+    sized_pool_resource(pool_t& p_pool, std::pmr::memory_resource* p_upstream = std::pmr::new_delete_resource())
+        : m_pool(p_pool)
+        , m_upstream(p_upstream)
+    {}
+
+    pool_t& pool()
+    {
+        return m_pool;
+    }
+
+private:
+    bool fits(size_t p_bytes, size_t p_alignment) const
+    {
+        return p_bytes <= m_pool.size() && p_alignment <= ALIGNMENT;
+    }
+
+    void* do_allocate(size_t p_bytes, size_t p_alignment) override
+    {
+        if (!fits(p_bytes, p_alignment))
+        {
+            return m_upstream->allocate(p_bytes, p_alignment);
+        }
+        return m_pool.allocate_raw();
+    }
+
+    void do_deallocate(void* p_ptr, size_t p_bytes, size_t p_alignment) override
+    {
+        if (!fits(p_bytes, p_alignment))
+        {
+            return m_upstream->deallocate(p_ptr, p_bytes, p_alignment);
+        }
+        m_pool.free(p_ptr);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& p_other) const noexcept override
+    {
+        return this == &p_other;
+    }
+
+    pool_t& m_pool;
+    std::pmr::memory_resource* m_upstream;
+};
+
+// Bump allocator over chunks taken from the upstream resource, deallocation
+// is a no-op. reset() rewinds to the first chunk and keeps up to
+// p_max_retained bytes of chunks, so a warmed up arena reset once per loop
+// iteration or per request never calls the upstream again while a burst
+// does not stay pinned. Not thread safe.
+class monotonic_arena : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t default_chunk_size = 64*1024;
+    static constexpr size_t unlimited = SIZE_MAX;
+
+    monotonic_arena(size_t p_chunk_size = default_chunk_size, std::pmr::memory_resource* p_upstream = std::pmr::new_delete_resource(),
+        size_t p_max_retained = unlimited)
+        : m_chunk_size(std::max(p_chunk_size, size_t(1)))
+        , m_max_retained(p_max_retained)
+        , m_upstream(p_upstream)
+    {}
+
+    monotonic_arena(const monotonic_arena&) = delete;
+    void operator=(const monotonic_arena&) = delete;
+
+    ~monotonic_arena()
+    {
+        release();
+    }
+
+    // Everything allocated before is invalid afterwards.
+    void reset()
+    {
+        while (m_capacity > m_max_retained)
+        {
+            pop_chunk();
+        }
+        m_current = 0;
+        m_offset = 0;
+        m_used = 0;
+    }
+
+    // Like reset() but also returns the chunks to the upstream resource.
+    void release()
+    {
+        while (m_chunks.size())
+        {
+            pop_chunk();
+        }
+        reset();
+    }
+
+    // Bytes handed out since the last reset.
+    size_t used() const
+    {
+        return m_used;
+    }
+
+    // Bytes held in chunks.
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+private:
+    struct chunk_t
+    {
+        std::byte* data;
+        size_t size;
+    };
+
+    void* do_allocate(size_t p_bytes, size_t p_alignment) override
+    {
+        while (m_current < m_chunks.size())
+        {
+            auto& chunk = m_chunks[m_current];
+            auto offset = aligned_offset(chunk, m_offset, p_alignment);
+            if (offset + p_bytes <= chunk.size)
+            {
+                m_offset = offset + p_bytes;
+                m_used += p_bytes;
+                return chunk.data + offset;
+            }
+            m_current++;
+            m_offset = 0;
+        }
+
+        auto size = std::max(m_chunk_size, p_bytes + p_alignment);
+        m_chunks.emplace_back(chunk_t{(std::byte*) m_upstream->allocate(size, alignof(std::max_align_t)), size});
+        m_capacity += size;
+        auto offset = aligned_offset(m_chunks.back(), 0, p_alignment);
+        m_offset = offset + p_bytes;
+        m_used += p_bytes;
+        return m_chunks.back().data + offset;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override
+    {}
+
+    void pop_chunk()
+    {
+        auto& chunk = m_chunks.back();
+        m_upstream->deallocate(chunk.data, chunk.size, alignof(std::max_align_t));
+        m_capacity -= chunk.size;
+        m_chunks.pop_back();
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& p_other) const noexcept override
+    {
+        return this == &p_other;
+    }
+
+    static size_t aligned_offset(const chunk_t& p_chunk, size_t p_offset, size_t p_alignment)
+    {
+        auto address = uintptr_t(p_chunk.data) + p_offset;
+        return ((address + p_alignment - 1) & ~(p_alignment - 1)) - uintptr_t(p_chunk.data);
+    }
+
+    const size_t m_chunk_size;
+    const size_t m_max_retained;
+    std::pmr::memory_resource* m_upstream;
+    std::vector<chunk_t> m_chunks;
+    size_t m_capacity = 0;
+    size_t m_current = 0;
+    size_t m_offset = 0;
+    size_t m_used = 0;
+};
+
+namespace detail
+{
+
+inline thread_local monotonic_arena* t_scratch = nullptr;
+
+} // namespace detail
+
+// Scratch arena of the reactor loop running on this thread, valid until the
+// end of the current loop iteration. Falls back to the default resource
+// outside of a loop.
+inline std::pmr::memory_resource* scratch_resource()
+{
+    if (detail::t_scratch)
+    {
+        return detail::t_scratch;
+    }
+    return std::pmr::get_default_resource();
+}
+
+// Makes p_arena the thread's scratch_resource() while in scope.
+class scoped_scratch
+{
+public:
+    scoped_scratch(monotonic_arena& p_arena)
+        : m_previous(detail::t_scratch)
+    {
+        detail::t_scratch = &p_arena;
+    }
+
+    scoped_scratch(const scoped_scratch&) = delete;
+    void operator=(const scoped_scratch&) = delete;
+
+    ~scoped_scratch()
+    {
+        detail::t_scratch = m_previous;
+    }
+
+private:
+    monotonic_arena* m_previous;
+};
+
+} // namespace bfc
+
+#endif // __BFC_MEMORY_RESOURCE_HPP__
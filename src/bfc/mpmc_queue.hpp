@@ -0,0 +1,223 @@
+#ifndef __BFC_MPMC_QUEUE_HPP__
+#define __BFC_MPMC_QUEUE_HPP__
+
+#include <new>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <stdexcept>
+
+namespace bfc
+{
+
+// Bounded lock free multi producer multi consumer ring. Every cell carries a
+// sequence number telling whether it is free for the producer of a given
+// round or full for its consumer, so producers and consumers only contend on
+// their own position counter. The capacity is rounded up to a power of two.
+template <typename T>
+class mpmc_queue
+{
+public:
+    mpmc_queue(size_t p_capacity)
+        : m_mask(round_up(p_capacity) - 1)
+        , m_cells(std::make_unique<cell_t[]>(m_mask + 1))
+    {
+        for (size_t i = 0; i <= m_mask; i++)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    void operator=(const mpmc_queue&) = delete;
+
+    ~mpmc_queue()
+    {
+        T discard;
+        while (try_pop(discard));
+    }
+
+    // Constructs the element in place from p_args, which are left untouched
+    // when the queue is full.
+    template <typename... args_t>
+    bool try_emplace(args_t&&... p_args)
+    {
+        auto pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        cell_t* cell;
+        while (true)
+        {
+            cell = &m_cells[pos & m_mask];
+            auto sequence = cell->sequence.load(std::memory_order_acquire);
+            auto diff = intptr_t(sequence) - intptr_t(pos);
+            if (0 == diff)
+            {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        try
+        {
+            new (cell->storage) T(std::forward<args_t>(p_args)...);
+        }
+        catch (...)
+        {
+            // The slot is taken, leave a default element for the consumer.
+            new (cell->storage) T();
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            throw;
+        }
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Claims up to p_count consecutive cells with a single CAS and constructs
+    // element i from the T returned by p_make(i), in order. Returns how many
+    // were pushed. A claimed cell whose previous element is still being
+    // moved out by its consumer is waited for. If p_make throws, the cells
+    // left are given default elements so consumers do not stall, then the
+    // exception is rethrown.
+    template <typename factory_t>
+    size_t try_emplace_bulk(size_t p_count, factory_t&& p_make)
+    {
+        auto pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        size_t count;
+        while (true)
+        {
+            // Positions below dequeue + capacity were taken by consumers.
+            auto free = intptr_t(m_dequeue_pos.load(std::memory_order_acquire) + m_mask + 1 - pos);
+            count = std::min(p_count, size_t(std::max<intptr_t>(free, 0)));
+            if (!count)
+            {
+                return 0;
+            }
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+
+        size_t i = 0;
+        try
+        {
+            for (; i < count; i++)
+            {
+                auto& cell = wait_cell(pos + i);
+                new (cell.storage) T(p_make(i));
+                cell.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+        }
+        catch (...)
+        {
+            // The cells are taken, leave default elements for the consumers.
+            for (; i < count; i++)
+            {
+                auto& cell = wait_cell(pos + i);
+                new (cell.storage) T();
+                cell.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            throw;
+        }
+        return count;
+    }
+
+    bool try_pop(T& p_out)
+    {
+        auto pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        cell_t* cell;
+        while (true)
+        {
+            cell = &m_cells[pos & m_mask];
+            auto sequence = cell->sequence.load(std::memory_order_acquire);
+            auto diff = intptr_t(sequence) - intptr_t(pos + 1);
+            if (0 == diff)
+            {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        auto& element = *std::launder((T*) cell->storage);
+        p_out = std::move(element);
+        element.~T();
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot while other threads push or pop.
+    size_t size() const
+    {
+        auto dequeue = m_dequeue_pos.load(std::memory_order_acquire);
+        auto enqueue = m_enqueue_pos.load(std::memory_order_acquire);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+    bool empty() const
+    {
+        return 0 == size();
+    }
+
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+private:
+    struct cell_t
+    {
+        std::atomic<size_t> sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+    };
+
+    // Waits for the consumer of the previous round to leave the cell.
+    cell_t& wait_cell(size_t p_pos)
+    {
+        auto& cell = m_cells[p_pos & m_mask];
+        while (cell.sequence.load(std::memory_order_acquire) != p_pos)
+        {
+            std::this_thread::yield();
+        }
+        return cell;
+    }
+
+    static size_t round_up(size_t p_capacity)
+    {
+        if (p_capacity < 2)
+        {
+            return 2;
+        }
+        return size_t(1) << (64 - __builtin_clzll(p_capacity - 1));
+    }
+
+    const size_t m_mask;
+    std::unique_ptr<cell_t[]> m_cells;
+    alignas(64) std::atomic<size_t> m_enqueue_pos{0};
+    alignas(64) std::atomic<size_t> m_dequeue_pos{0};
+};
+
+} // namespace bfc
+
+#endif // __BFC_MPMC_QUEUE_HPP__
@@ -0,0 +1,223 @@
+#ifndef __BFC_OBJECT_POOL_HPP__
+#define __BFC_OBJECT_POOL_HPP__
+
+#include <new>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+#include <bfc/memory_pool.hpp>
+
+namespace bfc
+{
+
+// Constructs objects in slots of a sized_memory_pool, so they come from
+// slabs and go through the calling thread's magazine like any other block.
+// Every slot gets a stable index when its slab is carved, an object can be
+// referred to by an index handle whose generation tells whether the object
+// it named is still alive.
+//
+// get() from another thread only tells the handle was live when checked,
+// the owner must not destroy the object while it is being used. Objects
+// still alive when the pool is destroyed are not destructed.
+template <typename T, typename allocator_t = heap_block_allocator>
+class object_pool
+{
+    struct slot_t
+    {
+        // Odd while an object lives in the slot.
+        std::atomic<uint32_t> generation;
+        uint32_t index;
+        alignas(T) std::byte storage[sizeof(T)];
+    };
+
+    class slot_allocator;
+    using pool_t = sized_memory_pool<alignof(slot_t), slot_allocator>;
+
+public:
+    struct handle
+    {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool operator==(const handle& p_other) const
+        {
+            return index == p_other.index && generation == p_other.generation;
+        }
+
+        bool operator!=(const handle& p_other) const
+        {
+            return !(*this == p_other);
+        }
+    };
+
+    struct deleter
+    {
+        object_pool* pool;
+
+        void operator()(T* p_obj) const
+        {
+            pool->destroy(p_obj);
+        }
+    };
+
+    using unique_ptr = std::unique_ptr<T, deleter>;
+
+    object_pool(allocator_t p_allocator = {}, size_t p_thread_cache = pool_t::default_thread_cache,
+        size_t p_slab_size = pool_t::default_slab_size)
+        : m_pool(sizeof(slot_t), slot_allocator(*this, std::move(p_allocator)), p_thread_cache, p_slab_size)
+    {}
+
+    object_pool(const object_pool&) = delete;
+    void operator=(const object_pool&) = delete;
+
+    ~object_pool()
+    {
+        for (auto& chunk : m_directory)
+        {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    template <typename... args_t>
+    T* construct(args_t&&... p_args)
+    {
+        auto slot = (slot_t*) m_pool.allocate_raw();
+        T* rv;
+        try
+        {
+            rv = new (slot->storage) T(std::forward<args_t>(p_args)...);
+        }
+        catch (...)
+        {
+            m_pool.free(slot);
+            throw;
+        }
+        slot->generation.store(slot->generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return rv;
+    }
+
+    void destroy(T* p_obj)
+    {
+        auto slot = slot_of(p_obj);
+        slot->generation.store(slot->generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        p_obj->~T();
+        m_pool.free(slot);
+    }
+
+    template <typename... args_t>
+    unique_ptr make_unique(args_t&&... p_args)
+    {
+        return unique_ptr(construct(std::forward<args_t>(p_args)...), deleter{this});
+    }
+
+    handle get_handle(const T* p_obj) const
+    {
+        auto slot = slot_of(p_obj);
+        return handle{slot->index, slot->generation.load(std::memory_order_relaxed)};
+    }
+
+    // Null when the handle's object was destroyed.
+    T* get(handle p_handle) const
+    {
+        if (p_handle.index >= m_slots.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        auto slot = directory_entry(p_handle.index).load(std::memory_order_acquire);
+        if (p_handle.generation != slot->generation.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return std::launder((T*) slot->storage);
+    }
+
+    // Carves slots for p_count objects ahead of time.
+    void reserve(size_t p_count)
+    {
+        m_pool.reserve(p_count);
+    }
+
+    memory_pool_stats stats()
+    {
+        return m_pool.stats();
+    }
+
+private:
+    // Numbers the slots of every slab it carves and records them in the
+    // directory, the pool calls it under its lock.
+    class slot_allocator
+    {
+    public:
+        slot_allocator(object_pool& p_owner, allocator_t p_allocator)
+            : m_owner(p_owner)
+            , m_allocator(std::move(p_allocator))
+        {}
+
+        std::byte* allocate(size_t p_size, size_t p_alignment)
+        {
+            auto rv = m_allocator.allocate(p_size, p_alignment);
+            for (size_t offset = 0; offset + sizeof(slot_t) <= p_size; offset += sizeof(slot_t))
+            {
+                m_owner.add_slot(new (rv + offset) slot_t{{0}, 0, {}});
+            }
+            return rv;
+        }
+
+        void deallocate(std::byte* p_ptr, size_t p_size, size_t p_alignment)
+        {
+            m_allocator.deallocate(p_ptr, p_size, p_alignment);
+        }
+
+    private:
+        object_pool& m_owner;
+        allocator_t m_allocator;
+    };
+
+    // The directory is split in chunks of 64, 128, 256... slots so it grows
+    // without moving the entries other threads may be reading.
+    static constexpr size_t first_chunk = 64;
+    static constexpr size_t chunk_count = 26;
+
+    static slot_t* slot_of(const T* p_obj)
+    {
+        return (slot_t*)((std::byte*) p_obj - offsetof(slot_t, storage));
+    }
+
+    std::atomic<slot_t*>& directory_entry(uint32_t p_index) const
+    {
+        size_t chunk = 63 - __builtin_clzll(p_index / first_chunk + 1);
+        size_t offset = p_index - first_chunk * ((size_t(1) << chunk) - 1);
+        return m_directory[chunk].load(std::memory_order_acquire)[offset];
+    }
+
+    void add_slot(slot_t* p_slot)
+    {
+        auto index = m_slots.load(std::memory_order_relaxed);
+        if (index == UINT32_MAX)
+        {
+            throw std::length_error("object_pool full");
+        }
+
+        size_t chunk = 63 - __builtin_clzll(index / first_chunk + 1);
+        if (!m_directory[chunk].load(std::memory_order_relaxed))
+        {
+            m_directory[chunk].store(new std::atomic<slot_t*>[first_chunk << chunk](), std::memory_order_release);
+        }
+
+        p_slot->index = index;
+        directory_entry(index).store(p_slot, std::memory_order_release);
+        m_slots.store(index + 1, std::memory_order_release);
+    }
+
+    mutable std::atomic<std::atomic<slot_t*>*> m_directory[chunk_count] = {};
+    std::atomic<uint32_t> m_slots{0};
+    pool_t m_pool;
+};
+
+} // namespace bfc
+
+#endif // __BFC_OBJECT_POOL_HPP__
@@ -0,0 +1,267 @@
+#ifndef __BFC_PARALLEL_HPP__
+#define __BFC_PARALLEL_HPP__
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+#include <bfc/latch.hpp>
+
+namespace bfc
+{
+
+// Data parallel algorithms over a thead_pool or a work_stealing_pool. The
+// range is split in chunks of p_grain indices (sized automatically when 0)
+// which the calling thread and up to size() pool tasks claim one after the
+// other, so a slow chunk does not hold the others back. The calling thread
+// only waits for the chunks others claimed to complete, helper tasks that
+// start later find nothing left and return, so a busy pool never holds the
+// caller back. On a work_stealing_pool worker it keeps executing tasks while
+// waiting so nested calls do not starve the pool, other threads sleep on the
+// latch. The first exception a chunk throws stops the remaining chunks and is
+// rethrown to the caller.
+
+namespace detail
+{
+
+template <typename pool_t, typename = void>
+struct has_wait_until : std::false_type
+{};
+
+template <typename pool_t>
+struct has_wait_until<pool_t, std::void_t<decltype(std::declval<pool_t&>().wait_until(std::declval<bool(*)()>()))>> : std::true_type
+{};
+
+// Shared by the caller and its helper tasks, which may outlive the call.
+// p_fn is only called for claimed chunks and the caller waits for every
+// chunk to complete, so it is never touched after the call returned.
+template <typename pool_t, typename = void>
+struct has_try_execute : std::false_type
+{};
+
+template <typename pool_t>
+struct has_try_execute<pool_t, std::void_t<decltype(std::declval<pool_t&>().try_execute(std::declval<void(*)()>()))>> : std::true_type
+{};
+
+template <typename chunk_fn_t>
+class parallel_job
+{
+public:
+    parallel_job(size_t p_begin, size_t p_end, size_t p_grain, chunk_fn_t& p_fn)
+        : done(1)
+        , m_next(p_begin)
+        , m_end(p_end)
+        , m_grain(p_grain)
+        , m_remaining((p_end - p_begin + p_grain - 1) / p_grain)
+        , m_fn(p_fn)
+    {}
+
+    // Runs chunks until none are left.
+    void work()
+    {
+        while (true)
+        {
+            auto begin = m_next.fetch_add(m_grain, std::memory_order_relaxed);
+            if (begin >= m_end)
+            {
+                return;
+            }
+
+            try
+            {
+                m_fn(begin, std::min(begin + m_grain, m_end));
+            }
+            catch (...)
+            {
+                {
+                    std::unique_lock<std::mutex> lg(m_error_mtx);
+                    if (!m_error)
+                    {
+                        m_error = std::current_exception();
+                    }
+                }
+                // The chunks nobody claimed yet are dropped.
+                auto next = m_next.exchange(m_end, std::memory_order_relaxed);
+                complete(1 + (next < m_end ? (m_end - next + m_grain - 1) / m_grain : 0));
+                return;
+            }
+            complete(1);
+        }
+    }
+
+    void rethrow()
+    {
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+    // Opens once every chunk completed or was dropped.
+    latch done;
+
+private:
+    void complete(size_t p_chunks)
+    {
+        if (p_chunks == m_remaining.fetch_sub(p_chunks, std::memory_order_acq_rel))
+        {
+            done.count_down();
+        }
+    }
+
+    std::atomic<size_t> m_next;
+    const size_t m_end;
+    const size_t m_grain;
+    std::atomic<size_t> m_remaining;
+    chunk_fn_t& m_fn;
+    std::mutex m_error_mtx;
+    std::exception_ptr m_error;
+};
+
+// Calls p_fn(chunk_begin, chunk_end) for the chunks of [p_begin, p_end).
+template <typename pool_t, typename chunk_fn_t>
+void parallel_chunks(pool_t& p_pool, size_t p_begin, size_t p_end, size_t p_grain, chunk_fn_t&& p_fn)
+{
+    if (p_begin >= p_end)
+    {
+        return;
+    }
+
+    auto count = p_end - p_begin;
+    if (!p_grain)
+    {
+        // About 8 chunks per participant to even out uneven chunks.
+        p_grain = std::max<size_t>(1, count / ((p_pool.size() + 1) * 8));
+    }
+
+    auto chunks = (count + p_grain - 1) / p_grain;
+    auto helpers = std::min(p_pool.size(), chunks - 1);
+    auto job = std::make_shared<parallel_job<std::remove_reference_t<chunk_fn_t>>>(p_begin, p_end, p_grain, p_fn);
+
+    // A helper the pool rejects is no loss, the caller runs what is left.
+    // Pools that can queue without blocking do, a full queue must not make
+    // the caller, possibly one of the pool's workers, wait for space.
+    for (size_t i=0; i<helpers; i++)
+    {
+        auto helper = [job]() {
+                job->work();
+            };
+
+        if constexpr (has_try_execute<pool_t>::value)
+        {
+            if (!p_pool.try_execute(helper))
+            {
+                break;
+            }
+        }
+        else
+        {
+            p_pool.execute(helper);
+        }
+    }
+
+    job->work();
+
+    // Only a worker has tasks to run meanwhile, other threads sleep.
+    bool waited = false;
+    if constexpr (has_wait_until<pool_t>::value)
+    {
+        if (p_pool.in_worker())
+        {
+            p_pool.wait_until([&job](){return job->done.try_wait();});
+            waited = true;
+        }
+    }
+    if (!waited)
+    {
+        job->done.wait();
+    }
+    job->rethrow();
+}
+
+} // namespace detail
+
+// Calls p_fn(i) for every i in [p_begin, p_end).
+template <typename pool_t, typename fn_t>
+void parallel_for(pool_t& p_pool, size_t p_begin, size_t p_end, fn_t&& p_fn, size_t p_grain = 0)
+{
+    detail::parallel_chunks(p_pool, p_begin, p_end, p_grain, [&p_fn](size_t p_chunk_begin, size_t p_chunk_end) {
+            for (auto i = p_chunk_begin; i < p_chunk_end; i++)
+            {
+                p_fn(i);
+            }
+        });
+}
+
+// Folds p_map(i) for every i in [p_begin, p_end) with p_reduce, starting
+// from p_identity. Chunks are combined in no particular order, p_reduce must
+// be associative and commutative.
+template <typename pool_t, typename T, typename map_t, typename reduce_t>
+T parallel_reduce(pool_t& p_pool, size_t p_begin, size_t p_end, T p_identity, map_t&& p_map, reduce_t&& p_reduce, size_t p_grain = 0)
+{
+    T rv = p_identity;
+    std::mutex rv_mtx;
+    detail::parallel_chunks(p_pool, p_begin, p_end, p_grain, [&](size_t p_chunk_begin, size_t p_chunk_end) {
+            T partial = p_identity;
+            for (auto i = p_chunk_begin; i < p_chunk_end; i++)
+            {
+                partial = p_reduce(std::move(partial), p_map(i));
+            }
+
+            std::unique_lock<std::mutex> lg(rv_mtx);
+            rv = p_reduce(std::move(rv), std::move(partial));
+        });
+    return rv;
+}
+
+// Writes p_fn(*(p_first + i)) to *(p_out + i), random access iterators only.
+template <typename pool_t, typename in_it_t, typename out_it_t, typename fn_t>
+out_it_t parallel_transform(pool_t& p_pool, in_it_t p_first, in_it_t p_last, out_it_t p_out, fn_t&& p_fn, size_t p_grain = 0)
+{
+    size_t count = std::distance(p_first, p_last);
+    parallel_for(p_pool, 0, count, [&](size_t i) {
+            p_out[i] = p_fn(p_first[i]);
+        }, p_grain);
+    return p_out + count;
+}
+
+// Merge sort: up to one run per participant is sorted with std::sort, then
+// runs are merged pairwise in parallel rounds. Not stable.
+template <typename pool_t, typename it_t, typename compare_t = std::less<>>
+void parallel_sort(pool_t& p_pool, it_t p_first, it_t p_last, compare_t p_compare = {}, size_t p_min_run = 4096)
+{
+    size_t count = std::distance(p_first, p_last);
+    size_t runs = 1;
+    while (runs < p_pool.size() + 1 && count / (runs * 2) >= std::max<size_t>(p_min_run, 1))
+    {
+        runs *= 2;
+    }
+
+    auto bound = [&](size_t p_run) {
+            return p_first + count * p_run / runs;
+        };
+
+    parallel_for(p_pool, 0, runs, [&](size_t i) {
+            std::sort(bound(i), bound(i + 1), p_compare);
+        }, 1);
+
+    for (size_t width = 1; width < runs; width *= 2)
+    {
+        parallel_for(p_pool, 0, runs / (width * 2), [&](size_t i) {
+                auto first = width * 2 * i;
+                std::inplace_merge(bound(first), bound(first + width), bound(first + width * 2), p_compare);
+            }, 1);
+    }
+}
+
+} // namespace bfc
+
+#endif // __BFC_PARALLEL_HPP__
@@ -0,0 +1,129 @@
+#ifndef __BFC_RING_BUFFER_HPP__
+#define __BFC_RING_BUFFER_HPP__
+
+#include <sys/mman.h>
+#include <sys/unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#include <bfc/buffer.hpp>
+
+namespace bfc
+{
+
+// Byte ring whose storage is mapped twice back to back, so readable and
+// writable spans are always contiguous even when they wrap around. Parsers
+// can look at a whole frame without the leftover being moved to the front.
+// Not thread safe.
+class mirrored_ring_buffer
+{
+public:
+    // The capacity is p_min_size rounded up to the page size.
+    mirrored_ring_buffer(size_t p_min_size)
+    {
+        size_t page = sysconf(_SC_PAGESIZE);
+        m_capacity = ((p_min_size + page - 1) / page) * page;
+
+        int fd = memfd_create("bfc_ring_buffer", MFD_CLOEXEC);
+        if (-1 == fd)
+        {
+            throw std::runtime_error(strerror(errno));
+        }
+
+        if (-1 == ftruncate(fd, m_capacity))
+        {
+            auto err = errno;
+            close(fd);
+            throw std::runtime_error(strerror(err));
+        }
+
+        // Reserve both halves first so the fixed mappings cannot clobber
+        // anything else.
+        auto base = (std::byte*) mmap(nullptr, 2*m_capacity, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == base)
+        {
+            auto err = errno;
+            close(fd);
+            throw std::runtime_error(strerror(err));
+        }
+
+        size_t region_size = 2*m_capacity;
+        m_region = buffer(base, region_size, [region_size](const void* p_ptr){munmap((void*) p_ptr, region_size);});
+
+        for (auto half : {base, base + m_capacity})
+        {
+            if (MAP_FAILED == mmap(half, m_capacity, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, fd, 0))
+            {
+                auto err = errno;
+                close(fd);
+                throw std::runtime_error(strerror(err));
+            }
+        }
+
+        close(fd);
+    }
+
+    mirrored_ring_buffer(const mirrored_ring_buffer&) = delete;
+    void operator=(const mirrored_ring_buffer&) = delete;
+    mirrored_ring_buffer(mirrored_ring_buffer&&) = default;
+    mirrored_ring_buffer& operator=(mirrored_ring_buffer&&) = default;
+
+    // Free space to read into, followed by commit() of the bytes written.
+    buffer_view writable() const
+    {
+        return buffer_view(m_region.data() + (m_write % m_capacity), m_capacity - size());
+    }
+
+    void commit(size_t p_size)
+    {
+        if (p_size > m_capacity - size())
+        {
+            throw std::out_of_range("mirrored_ring_buffer::commit");
+        }
+        m_write += p_size;
+    }
+
+    // Pending data to parse, followed by consume() of the bytes used.
+    buffer_view readable() const
+    {
+        return buffer_view(m_region.data() + (m_read % m_capacity), size());
+    }
+
+    void consume(size_t p_size)
+    {
+        if (p_size > size())
+        {
+            throw std::out_of_range("mirrored_ring_buffer::consume");
+        }
+        m_read += p_size;
+    }
+
+    void clear()
+    {
+        m_read = 0;
+        m_write = 0;
+    }
+
+    size_t size() const
+    {
+        return m_write - m_read;
+    }
+
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+private:
+    buffer m_region;
+    size_t m_capacity = 0;
+    uint64_t m_read = 0;
+    uint64_t m_write = 0;
+};
+
+} // namespace bfc
+
+#endif // __BFC_RING_BUFFER_HPP__
@@ -0,0 +1,214 @@
+#ifndef __BFC_SHARED_BUFFER_HPP__
+#define __BFC_SHARED_BUFFER_HPP__
+
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include <bfc/buffer.hpp>
+#include <bfc/memory_pool.hpp>
+
+namespace bfc
+{
+
+namespace detail
+{
+
+// Lives at the start of every shared block, the payload follows it.
+struct shared_block_header
+{
+    std::atomic<uint32_t> refcount;
+    void (*release)(void* p_owner, shared_block_header* p_block);
+    void* owner;
+    size_t capacity;
+};
+
+constexpr size_t shared_block_header_size =
+    (sizeof(shared_block_header) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+} // namespace detail
+
+// Reference counted view over a shared block, copies and slices keep the
+// block alive and the last one returns it to its owner.
+class shared_buffer
+{
+public:
+    shared_buffer() = default;
+
+    shared_buffer(const shared_buffer& p_other) noexcept
+        : m_block(p_other.m_block)
+        , m_data(p_other.m_data)
+        , m_size(p_other.m_size)
+    {
+        acquire();
+    }
+
+    shared_buffer(shared_buffer&& p_other) noexcept
+        : m_block(p_other.m_block)
+        , m_data(p_other.m_data)
+        , m_size(p_other.m_size)
+    {
+        p_other.clear();
+    }
+
+    shared_buffer& operator=(const shared_buffer& p_other) noexcept
+    {
+        if (this != &p_other)
+        {
+            reset();
+            m_block = p_other.m_block;
+            m_data = p_other.m_data;
+            m_size = p_other.m_size;
+            acquire();
+        }
+        return *this;
+    }
+
+    shared_buffer& operator=(shared_buffer&& p_other) noexcept
+    {
+        if (this != &p_other)
+        {
+            reset();
+            m_block = p_other.m_block;
+            m_data = p_other.m_data;
+            m_size = p_other.m_size;
+            p_other.clear();
+        }
+        return *this;
+    }
+
+    ~shared_buffer()
+    {
+        reset();
+    }
+
+    // Takes ownership of a block with a refcount of one.
+    static shared_buffer adopt(detail::shared_block_header* p_block, size_t p_size)
+    {
+        shared_buffer rv;
+        rv.m_block = p_block;
+        rv.m_data = (std::byte*) p_block + detail::shared_block_header_size;
+        rv.m_size = p_size;
+        return rv;
+    }
+
+    shared_buffer slice(size_t p_offset, size_t p_size) const
+    {
+        if (p_offset > m_size || p_size > m_size - p_offset)
+        {
+            throw std::out_of_range("shared_buffer::slice");
+        }
+
+        shared_buffer rv(*this);
+        rv.m_data += p_offset;
+        rv.m_size = p_size;
+        return rv;
+    }
+
+    shared_buffer slice(size_t p_offset) const
+    {
+        return slice(p_offset, m_size - std::min(p_offset, m_size));
+    }
+
+    std::byte* data() const
+    {
+        return m_data;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    uint32_t use_count() const
+    {
+        return m_block ? m_block->refcount.load(std::memory_order_relaxed) : 0;
+    }
+
+    explicit operator bool() const
+    {
+        return m_block;
+    }
+
+    void reset() noexcept
+    {
+        if (m_block && 1 == m_block->refcount.fetch_sub(1, std::memory_order_acq_rel))
+        {
+            m_block->release(m_block->owner, m_block);
+        }
+        clear();
+    }
+
+private:
+    void acquire() noexcept
+    {
+        if (m_block)
+        {
+            m_block->refcount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void clear() noexcept
+    {
+        m_block = nullptr;
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    detail::shared_block_header* m_block = nullptr;
+    std::byte* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// Hands out shared_buffers of a fixed size carved from a sized_memory_pool,
+// the block header is accounted for in the pool's block size. The pool must
+// outlive every buffer it handed out.
+template <size_t ALIGNMENT = alignof(std::max_align_t)>
+class shared_buffer_pool
+{
+public:
+    shared_buffer_pool(size_t p_size)
+        : m_size(p_size)
+        , m_pool(p_size + detail::shared_block_header_size)
+    {}
+
+    shared_buffer allocate()
+    {
+        auto block = new (m_pool.allocate_raw()) detail::shared_block_header{{1}, &release, this, m_size};
+        return shared_buffer::adopt(block, m_size);
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    static void release(void* p_owner, detail::shared_block_header* p_block)
+    {
+        auto& self = *(shared_buffer_pool*) p_owner;
+        p_block->~shared_block_header();
+        self.m_pool.free(p_block);
+    }
+
+    const size_t m_size;
+    sized_memory_pool<ALIGNMENT> m_pool;
+};
+
+// Heap backed shared_buffer for sizes without a pool.
+inline shared_buffer make_shared_buffer(size_t p_size)
+{
+    auto raw = operator new[](detail::shared_block_header_size + p_size, std::align_val_t{alignof(std::max_align_t)});
+    auto block = new (raw) detail::shared_block_header{{1},
+        [](void*, detail::shared_block_header* p_block) {
+            p_block->~shared_block_header();
+            operator delete[](p_block, std::align_val_t{alignof(std::max_align_t)});
+        },
+        nullptr, p_size};
+    return shared_buffer::adopt(block, p_size);
+}
+
+} // namespace bfc
+
+#endif // __BFC_SHARED_BUFFER_HPP__
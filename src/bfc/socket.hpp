@@ -12,6 +12,7 @@
 #include <stdexcept>
 
 #include <bfc/buffer.hpp>
+#include <bfc/buffer_chain.hpp>
 
 namespace bfc
 {
@@ -173,6 +174,24 @@ public:
         return ::send(m_fd, p_data.data(), p_data.size(), p_flags);
     }
 
+    // Gathers all segments of the chain in a single sendmsg.
+    template <size_t N>
+    ssize_t send(const buffer_chain<N>& p_data, int p_flags, const sockaddr* p_to, socklen_t p_to_size)
+    {
+        msghdr msg{};
+        msg.msg_name = (void*) p_to;
+        msg.msg_namelen = p_to_size;
+        msg.msg_iov = (iovec*) p_data.iov();
+        msg.msg_iovlen = p_data.count();
+        return ::sendmsg(m_fd, &msg, p_flags);
+    }
+
+    template <size_t N>
+    ssize_t send(const buffer_chain<N>& p_data, int p_flags = 0)
+    {
+        return send(p_data, p_flags, nullptr, 0);
+    }
+
     template <typename T>
     ssize_t recv(T&& p_data, int p_flags, sockaddr* p_addr, socklen_t* p_addr_sz)
     {
@@ -185,6 +204,44 @@ public:
         return ::recv(m_fd, p_data.data(), p_data.size(), p_flags);
     }
 
+    // Scatters the received data over the segments of the chain in a single
+    // recvmsg.
+    template <size_t N>
+    ssize_t recv(buffer_chain<N>& p_data, int p_flags, sockaddr* p_addr, socklen_t* p_addr_sz)
+    {
+        msghdr msg{};
+        msg.msg_name = p_addr;
+        msg.msg_namelen = p_addr_sz ? *p_addr_sz : 0;
+        msg.msg_iov = p_data.iov();
+        msg.msg_iovlen = p_data.count();
+        auto rv = ::recvmsg(m_fd, &msg, p_flags);
+        if (p_addr_sz)
+        {
+            *p_addr_sz = msg.msg_namelen;
+        }
+        return rv;
+    }
+
+    template <size_t N>
+    ssize_t recv(buffer_chain<N>& p_data, int p_flags)
+    {
+        return recv(p_data, p_flags, nullptr, nullptr);
+    }
+
+    // A temporary chain, e.g. built in the call, would otherwise pick the
+    // generic overloads.
+    template <size_t N>
+    ssize_t recv(buffer_chain<N>&& p_data, int p_flags, sockaddr* p_addr, socklen_t* p_addr_sz)
+    {
+        return recv(p_data, p_flags, p_addr, p_addr_sz);
+    }
+
+    template <size_t N>
+    ssize_t recv(buffer_chain<N>&& p_data, int p_flags)
+    {
+        return recv(p_data, p_flags, nullptr, nullptr);
+    }
+
     int set_sock_opt(int p_level, int p_name, const void *p_value, socklen_t p_len)
     {
         return setsockopt(m_fd, p_level, p_name, p_value, p_len);
@@ -0,0 +1,386 @@
+#ifndef __BFC_THREAD_PLACEMENT_HPP__
+#define __BFC_THREAD_PLACEMENT_HPP__
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <set>
+#include <string>
+#include <vector>
+#include <thread>
+#include <future>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <cctype>
+#include <cstring>
+
+#include <bfc/configuration_parser.hpp>
+
+namespace bfc
+{
+
+// Parses the kernel's CPU list format, e.g. "0-3,8,10-11". CPUs a cpu_set_t
+// cannot hold, CPU_SETSIZE and above, are rejected.
+inline std::vector<int> parse_cpu_list(std::string_view p_list)
+{
+    std::vector<int> rv;
+    while (p_list.size())
+    {
+        auto comma = p_list.find(',');
+        auto item = p_list.substr(0, comma);
+        p_list = comma == std::string_view::npos ? std::string_view() : p_list.substr(comma + 1);
+
+        while (item.size() && std::isspace((unsigned char) item.front()))
+        {
+            item.remove_prefix(1);
+        }
+        while (item.size() && std::isspace((unsigned char) item.back()))
+        {
+            item.remove_suffix(1);
+        }
+        if (item.empty())
+        {
+            continue;
+        }
+
+        auto dash = item.find('-');
+        try
+        {
+            auto first = std::stoi(std::string(item.substr(0, dash)));
+            auto last = dash == std::string_view::npos ? first : std::stoi(std::string(item.substr(dash + 1)));
+            if (first < 0 || last < first || last >= CPU_SETSIZE)
+            {
+                throw std::invalid_argument("");
+            }
+            for (auto i = first; i <= last; i++)
+            {
+                rv.push_back(i);
+            }
+        }
+        catch (const std::logic_error&)
+        {
+            throw std::invalid_argument("invalid cpu list: " + std::string(item));
+        }
+    }
+    return rv;
+}
+
+// CPUs of the machine with the core and package each belongs to, read from
+// the sysfs CPU directory.
+class cpu_topology
+{
+public:
+    struct cpu_t
+    {
+        int cpu;
+        int core;
+        int package;
+    };
+
+    cpu_topology() = default;
+
+    cpu_topology(std::vector<cpu_t> p_cpus)
+        : m_cpus(std::move(p_cpus))
+    {}
+
+    // Only online CPUs. A CPU without topology information is its own core.
+    static cpu_topology load(const std::string& p_root = "/sys/devices/system/cpu")
+    {
+        std::vector<cpu_t> cpus;
+        for (auto cpu : parse_cpu_list(read_line(p_root + "/online")))
+        {
+            auto topology = p_root + "/cpu" + std::to_string(cpu) + "/topology/";
+            cpus.push_back(cpu_t{cpu, read_int(topology + "core_id", cpu), read_int(topology + "physical_package_id", 0)});
+        }
+        return cpu_topology(std::move(cpus));
+    }
+
+    const std::vector<cpu_t>& cpus() const
+    {
+        return m_cpus;
+    }
+
+    std::vector<int> all() const
+    {
+        std::vector<int> rv;
+        for (auto& i : m_cpus)
+        {
+            rv.push_back(i.cpu);
+        }
+        return rv;
+    }
+
+    // The first CPU of every physical core, leaving SMT siblings out.
+    std::vector<int> primary() const
+    {
+        std::vector<int> rv;
+        std::set<std::pair<int, int>> cores;
+        for (auto& i : m_cpus)
+        {
+            if (cores.emplace(i.package, i.core).second)
+            {
+                rv.push_back(i.cpu);
+            }
+        }
+        return rv;
+    }
+
+    // p_cpus without the CPUs sharing a physical core with any of p_excluded.
+    std::vector<int> exclude_cores(const std::vector<int>& p_cpus, const std::vector<int>& p_excluded) const
+    {
+        std::set<std::pair<int, int>> cores;
+        for (auto& i : m_cpus)
+        {
+            if (std::count(p_excluded.begin(), p_excluded.end(), i.cpu))
+            {
+                cores.emplace(i.package, i.core);
+            }
+        }
+
+        std::vector<int> rv;
+        for (auto cpu : p_cpus)
+        {
+            auto info = std::find_if(m_cpus.begin(), m_cpus.end(), [cpu](const cpu_t& p_info){return p_info.cpu == cpu;});
+            bool excluded = info == m_cpus.end() ?
+                std::count(p_excluded.begin(), p_excluded.end(), cpu) > 0 :
+                cores.count({info->package, info->core}) > 0;
+            if (!excluded)
+            {
+                rv.push_back(cpu);
+            }
+        }
+        return rv;
+    }
+
+private:
+    static std::string read_line(const std::string& p_path)
+    {
+        std::ifstream in(p_path);
+        std::string rv;
+        std::getline(in, rv);
+        return rv;
+    }
+
+    static int read_int(const std::string& p_path, int p_default)
+    {
+        std::ifstream in(p_path);
+        int rv;
+        if (!(in >> rv))
+        {
+            return p_default;
+        }
+        return rv;
+    }
+
+    std::vector<cpu_t> m_cpus;
+};
+
+// Where the threads of a pool or a reactor run and how they are named. With
+// pinning the i-th thread is bound to cpus[i % cpus.size()], otherwise every
+// thread may run on any of the CPUs. An empty CPU list leaves the affinity
+// alone and an empty name leaves the name alone, so a default constructed
+// placement does nothing.
+class thread_placement
+{
+public:
+    thread_placement() = default;
+
+    // Throws std::invalid_argument for CPUs outside [0, CPU_SETSIZE).
+    thread_placement(std::string p_name, std::vector<int> p_cpus = {}, bool p_pin = true)
+        : m_name(std::move(p_name))
+        , m_cpus(std::move(p_cpus))
+        , m_pin(p_pin)
+    {
+        check_cpus();
+    }
+
+    // Reads, for p_prefix "workers":
+    //   workers.name          thread name, the thread index is appended
+    //   workers.cpus          CPU list, all online CPUs when missing
+    //   workers.smt           0 keeps only the first CPU of every core
+    //   workers.exclude_cores CPU list whose whole cores are left out
+    //   workers.pin           0 lets every thread run on all the CPUs
+    // CPU selection only happens when one of the CPU keys is present.
+    static thread_placement from_config(const args_map& p_config, std::string_view p_prefix, const cpu_topology& p_topology = cpu_topology::load())
+    {
+        auto key = [&p_prefix](const char* p_name) {
+                return std::string(p_prefix) + "." + p_name;
+            };
+
+        thread_placement rv(p_config.arg(key("name")).value_or(""));
+        rv.m_pin = p_config.as<int>(key("pin")).value_or(1);
+
+        auto cpus = p_config.arg(key("cpus"));
+        auto smt = p_config.as<int>(key("smt"));
+        auto excluded = p_config.arg(key("exclude_cores"));
+        if (!cpus && !smt && !excluded)
+        {
+            return rv;
+        }
+
+        rv.m_cpus = cpus ? parse_cpu_list(*cpus) : p_topology.all();
+        if (smt && !*smt)
+        {
+            auto primary = p_topology.primary();
+            rv.m_cpus.erase(std::remove_if(rv.m_cpus.begin(), rv.m_cpus.end(), [&primary](int p_cpu) {
+                    return !std::count(primary.begin(), primary.end(), p_cpu);
+                }), rv.m_cpus.end());
+        }
+        if (excluded)
+        {
+            rv.m_cpus = p_topology.exclude_cores(rv.m_cpus, parse_cpu_list(*excluded));
+        }
+        if (rv.m_cpus.empty())
+        {
+            throw std::invalid_argument(std::string(p_prefix) + ": no CPU left to run on");
+        }
+        rv.check_cpus();
+        return rv;
+    }
+
+    const std::string& name() const
+    {
+        return m_name;
+    }
+
+    const std::vector<int>& cpus() const
+    {
+        return m_cpus;
+    }
+
+    bool pinned() const
+    {
+        return m_pin;
+    }
+
+    // Places p_thread as the p_index-th thread of its group.
+    void apply(pthread_t p_thread, size_t p_index) const
+    {
+        if (m_cpus.size())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (m_pin)
+            {
+                CPU_SET(m_cpus[p_index % m_cpus.size()], &set);
+            }
+            else
+            {
+                for (auto cpu : m_cpus)
+                {
+                    CPU_SET(cpu, &set);
+                }
+            }
+
+            auto res = pthread_setaffinity_np(p_thread, sizeof(set), &set);
+            if (res)
+            {
+                throw std::runtime_error(strerror(res));
+            }
+        }
+
+        if (m_name.size())
+        {
+            // Linux limits names to 15 characters, the index is kept.
+            auto index = std::to_string(p_index);
+            auto name = m_name.substr(0, 15 - index.size()) + index;
+
+            auto res = pthread_setname_np(p_thread, name.c_str());
+            if (res)
+            {
+                throw std::runtime_error(strerror(res));
+            }
+        }
+    }
+
+    void apply(std::thread& p_thread, size_t p_index) const
+    {
+        apply(p_thread.native_handle(), p_index);
+    }
+
+    void apply_self(size_t p_index = 0) const
+    {
+        apply(pthread_self(), p_index);
+    }
+
+private:
+    void check_cpus() const
+    {
+        for (auto cpu : m_cpus)
+        {
+            if (cpu < 0 || cpu >= CPU_SETSIZE)
+            {
+                throw std::invalid_argument("cpu out of range: " + std::to_string(cpu));
+            }
+        }
+    }
+
+    std::string m_name;
+    std::vector<int> m_cpus;
+    bool m_pin = true;
+};
+
+// Runs a reactor's loop on its own placed thread, stops the reactor and
+// joins the thread on destruction. The loop only starts once the thread is
+// placed, if placement fails the thread exits without running it.
+template <typename reactor_t>
+class reactor_runner
+{
+public:
+    reactor_runner(reactor_t& p_reactor, const thread_placement& p_placement = {})
+        : m_reactor(p_reactor)
+    {
+        std::promise<bool> placed;
+        m_thread = std::thread([this, go = placed.get_future()]() mutable {
+                if (go.get())
+                {
+                    m_reactor.run();
+                }
+            });
+
+        try
+        {
+            p_placement.apply(m_thread, 0);
+        }
+        catch (...)
+        {
+            placed.set_value(false);
+            m_thread.join();
+            throw;
+        }
+        placed.set_value(true);
+    }
+
+    reactor_runner(const reactor_runner&) = delete;
+    void operator=(const reactor_runner&) = delete;
+
+    ~reactor_runner()
+    {
+        stop();
+    }
+
+    std::thread::id get_id() const
+    {
+        return m_thread.get_id();
+    }
+
+private:
+    void stop()
+    {
+        if (m_thread.joinable())
+        {
+            m_reactor.wake_up([this](){m_reactor.stop();});
+            m_thread.join();
+        }
+    }
+
+    reactor_t& m_reactor;
+    std::thread m_thread;
+};
+
+} // namespace bfc
+
+#endif // __BFC_THREAD_PLACEMENT_HPP__
@@ -6,111 +6,616 @@
 #include <thread>
 #include <future>
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <condition_variable>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 #include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
 
 #include <bfc/function.hpp>
+#include <bfc/future.hpp>
+#include <bfc/idle_policy.hpp>
+#include <bfc/mpmc_queue.hpp>
+#include <bfc/thread_placement.hpp>
 
 namespace bfc
 {
 
+// What execute() does when the task queue is full.
+enum class overflow_policy
+{
+    // Wait for a worker to take a task off the queue.
+    block,
+    // Return false and leave the task to the caller.
+    reject,
+    // Run the task on the calling thread.
+    run_inline
+};
+
+// Bounds of an elastic thead_pool. The pool starts min_size workers and
+// spawns another, up to max_size, when a task waited in the queue longer
+// than grow_after while no worker was parked. A worker parked for
+// idle_timeout exits as long as more than min_size remain. min_size must be
+// at least one, with no worker left nothing would take queued tasks.
+struct elastic_policy
+{
+    size_t min_size = 1;
+    size_t max_size = 4;
+    std::chrono::microseconds grow_after = std::chrono::milliseconds(1);
+    std::chrono::milliseconds idle_timeout = std::chrono::seconds(10);
+};
+
+// Workers pull tasks from a bounded lock free queue, so submitting only
+// blocks, if at all, when the queue is full. Workers park on a condition
+// variable when there is nothing to do and are only notified when one is
+// parked. Tasks still queued when the pool is destroyed are run first.
 template <typename function_t = light_function<void()>>
 class thead_pool
 {
 public:
     using fn_t = function_t;
-    thead_pool(size_t p_max_size = 4)
-        : m_max_size(p_max_size)
+
+    // p_placement names the workers and sets their CPU affinity, p_idle is
+    // how long an idle worker spins before it parks.
+    thead_pool(size_t p_max_size = 4, size_t p_queue_size = 1024, overflow_policy p_overflow = overflow_policy::block,
+        const thread_placement& p_placement = {}, const idle_policy& p_idle = {})
+        : thead_pool(elastic_policy{p_max_size, p_max_size}, p_queue_size, p_overflow, p_placement, p_idle)
+    {}
+
+    thead_pool(const elastic_policy& p_elastic, size_t p_queue_size = 1024, overflow_policy p_overflow = overflow_policy::block,
+        const thread_placement& p_placement = {}, const idle_policy& p_idle = {})
+        : m_min_size(p_elastic.min_size)
+        , m_max_size(std::max(p_elastic.min_size, p_elastic.max_size))
+        , m_elastic(m_min_size < m_max_size)
+        , m_grow_after(std::chrono::duration_cast<std::chrono::nanoseconds>(p_elastic.grow_after).count())
+        , m_idle_timeout(p_elastic.idle_timeout)
+        , m_overflow(p_overflow)
+        , m_placement(p_placement)
+        , m_idle(p_idle)
+        , m_queue(p_queue_size)
+        , m_slots(m_max_size)
+        , m_last_pop(now())
     {
-        std::unique_lock<std::mutex> lg(m_free_mtx);
-        for (auto i=0u; i<m_max_size; i++)
+        if (!m_min_size)
         {
-            m_free.emplace_back(i);
-            m_pool.emplace_back(std::make_unique<thread_entry>());
-            auto& entry = *(m_pool.back());
-            entry.functor = {};
+            throw std::invalid_argument("thead_pool needs at least one worker");
+        }
 
-            entry.thread = std::thread([this, use_index = i, &entry]()
-                {
-                    auto pred = [&]() {return entry.functor || !m_is_running;};
-                    while(true)
-                    {
-                        std::unique_lock<std::mutex> lg(entry.entry_mtx);
-
-                        if (entry.functor)
-                        {
-                            entry.functor();
-                            entry.functor = {};
-                            std::unique_lock<std::mutex> lg(m_free_mtx);
-                            m_free.emplace_back(use_index);
-                        }
-
-                        if (!m_is_running)
-                        {
-                            return;
-                        }
-
-                        m_max_size_cv.notify_one();
-
-                        entry.thread_cv.wait(lg, pred);
-                    }
-                });
+        try
+        {
+            for (auto i=0u; i<m_min_size; i++)
+            {
+                spawn();
+            }
+        }
+        catch (...)
+        {
+            stop();
+            throw;
         }
     }
-    
+
     ~thead_pool()
     {
-        m_is_running = false;
-        for (auto& i : m_pool)
+        stop();
+    }
+
+    // Returns false if the task will not run: the queue was full and the
+    // policy is reject, or the pool stopped, also while the caller was
+    // blocked waiting for space. p_functor is left untouched then.
+    template <typename callable_t>
+    bool execute(callable_t&& p_functor)
+    {
+        if (try_execute(std::forward<callable_t>(p_functor)))
+        {
+            return true;
+        }
+
+        switch (m_overflow)
+        {
+            case overflow_policy::reject:
+                return false;
+            case overflow_policy::run_inline:
+                p_functor();
+                return true;
+            case overflow_policy::block:
+                break;
+        }
+
+        std::unique_lock<std::mutex> lg(m_space_mtx);
+        m_blocked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool rv = false;
+        m_space_cv.wait(lg, [&](){
+                rv = try_execute(std::forward<callable_t>(p_functor));
+                return rv || !m_is_running;
+            });
+        m_blocked.fetch_sub(1);
+        return rv;
+    }
+
+    // Never blocks, p_functor is left untouched when the queue is full or
+    // the pool stopped.
+    template <typename callable_t>
+    bool try_execute(callable_t&& p_functor)
+    {
+        if (!m_is_running.load(std::memory_order_acquire) || !m_queue.try_emplace(std::forward<callable_t>(p_functor), m_elastic ? now() : 0))
         {
-            i->thread_cv.notify_one();
-            i->thread.join();
+            return false;
         }
+
+        wake(1);
+        return true;
     }
-    void execute(function_t p_functor)
+
+    // Queues the callables of [p_first, p_last), copied or moved as *p_first
+    // yields them, claiming queue space for as many as fit at once and waking
+    // at most one parked worker per task. Returns how many were queued or run
+    // inline. With the reject policy, or once the pool stopped, the tasks
+    // past that count are left untouched. If copying a task throws, the tasks before it stay queued
+    // and the exception propagates.
+    template <typename it_t>
+    size_t execute_bulk(it_t p_first, it_t p_last)
     {
-        std::unique_lock<std::mutex> lg(m_free_mtx);
+        size_t count = std::distance(p_first, p_last);
+        auto done = try_execute_bulk(p_first, p_last);
+        if (done == count)
+        {
+            return count;
+        }
+        std::advance(p_first, done);
+
+        switch (m_overflow)
+        {
+            case overflow_policy::reject:
+                return done;
+            case overflow_policy::run_inline:
+                for (; p_first != p_last; ++p_first)
+                {
+                    (*p_first)();
+                }
+                return count;
+            case overflow_policy::block:
+                break;
+        }
 
-        m_max_size_cv.wait(lg, [this](){
-                return m_free.size();
+        std::unique_lock<std::mutex> lg(m_space_mtx);
+        m_blocked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        m_space_cv.wait(lg, [&](){
+                auto queued = try_execute_bulk(p_first, p_last);
+                std::advance(p_first, queued);
+                done += queued;
+                return p_first == p_last || !m_is_running;
             });
+        m_blocked.fetch_sub(1);
+        return done;
+    }
+
+    // Never blocks, returns how many of the leading tasks were queued.
+    template <typename it_t>
+    size_t try_execute_bulk(it_t p_first, it_t p_last)
+    {
+        if (!m_is_running.load(std::memory_order_acquire))
+        {
+            return 0;
+        }
+
+        auto queued_at = m_elastic ? now() : 0;
+        size_t made = 0;
+        size_t queued;
+        try
+        {
+            queued = m_queue.try_emplace_bulk(std::distance(p_first, p_last), [&p_first, &made, queued_at](size_t) {
+                    entry_t rv(*p_first, queued_at);
+                    ++p_first;
+                    made++;
+                    return rv;
+                });
+        }
+        catch (...)
+        {
+            // The tasks made before the throwing one are queued and run.
+            if (made)
+            {
+                wake(made);
+            }
+            throw;
+        }
+        if (queued)
+        {
+            wake(queued);
+        }
+        return queued;
+    }
 
-        auto use_index = m_free.back();
-        m_free.pop_back();
-        auto& entry = *m_pool[use_index];
+    // Like execute() but returns a future of p_functor's result. The task
+    // only adds the shared state's pointer to the callable, so it must fit
+    // function_t with one more pointer. A task that was not queued completes
+    // the future with an exception.
+    template <typename callable_t>
+    auto submit(callable_t&& p_functor)
+    {
+        using result_t = std::invoke_result_t<std::decay_t<callable_t>&>;
+        auto state = detail::future_state<result_t>::create();
+        future<result_t> rv(state);
 
-        std::unique_lock<std::mutex> lgEntry(entry.entry_mtx);
-        entry.functor = std::move(p_functor);
-        entry.thread_cv.notify_one();
+        bool queued;
+        try
+        {
+            queued = execute([state, fn = std::decay_t<callable_t>(std::forward<callable_t>(p_functor))]() mutable {
+                    state->run(fn);
+                });
+        }
+        catch (...)
+        {
+            // The task never reached the queue, drop the producer's reference.
+            state->release();
+            throw;
+        }
+        if (!queued)
+        {
+            state->set_exception(std::make_exception_ptr(std::runtime_error("thead_pool rejected the task")));
+            state->release();
+        }
+        return rv;
     }
 
     size_t count_active() const
     {
-        std::unique_lock<std::mutex> lg(m_free_mtx);
-        return m_pool.size() - m_free.size();
+        return m_active.load(std::memory_order_relaxed);
+    }
+
+    size_t count_queued() const
+    {
+        return m_queue.size();
     }
 
+    // Current number of workers.
     size_t size() const
     {
-        std::unique_lock<std::mutex> lg(m_free_mtx);
-        return m_pool.size();
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+    size_t min_size() const
+    {
+        return m_min_size;
+    }
+
+    size_t max_size() const
+    {
+        return m_max_size;
+    }
+
+    // Workers started beyond min_size and workers retired for idleness.
+    size_t count_grown() const
+    {
+        return m_grown.load(std::memory_order_relaxed);
     }
+
+    size_t count_retired() const
+    {
+        return m_retired_count.load(std::memory_order_relaxed);
+    }
+
 private:
-    struct thread_entry
+    struct entry_t
     {
-        function_t functor;
-        std::thread thread;
-        std::condition_variable thread_cv;
-        std::mutex entry_mtx;
+        entry_t() = default;
+
+        template <typename callable_t>
+        entry_t(callable_t&& p_functor, int64_t p_queued_at)
+            : task(std::forward<callable_t>(p_functor))
+            , queued_at(p_queued_at)
+        {}
+
+        function_t task;
+        int64_t queued_at = 0;
     };
 
-    bool m_is_running = true;
-    std::vector<std::unique_ptr<thread_entry>> m_pool;
-    size_t m_max_size = 8;
-    std::condition_variable m_max_size_cv;
-    std::vector<size_t> m_free;
-    mutable std::mutex m_free_mtx;
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Notifies up to p_count parked workers after p_count tasks were queued.
+    void wake(size_t p_count)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto parked = m_parked.load(std::memory_order_relaxed);
+        if (parked)
+        {
+            std::unique_lock<std::mutex> lg(m_park_mtx);
+            if (p_count >= parked)
+            {
+                m_work_cv.notify_all();
+                return;
+            }
+            for (size_t i=0; i<p_count; i++)
+            {
+                m_work_cv.notify_one();
+            }
+        }
+        else if (m_elastic && !m_spinning.load(std::memory_order_relaxed) &&
+            now() - m_last_pop.load(std::memory_order_relaxed) > m_grow_after)
+        {
+            // Every worker is busy and none took a task for a while.
+            grow();
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::unique_lock<std::mutex> lg(m_park_mtx);
+            m_is_running = false;
+        }
+        m_work_cv.notify_all();
+        {
+            std::unique_lock<std::mutex> lg(m_space_mtx);
+        }
+        m_space_cv.notify_all();
+
+        std::vector<std::thread> threads;
+        {
+            std::unique_lock<std::mutex> lg(m_threads_mtx);
+            threads.swap(m_threads);
+            std::move(m_retired.begin(), m_retired.end(), std::back_inserter(threads));
+            m_retired.clear();
+        }
+
+        for (auto& i : threads)
+        {
+            i.join();
+        }
+
+        // Queued by a producer that checked m_is_running just before it
+        // changed, after the last worker found the queue empty.
+        entry_t entry;
+        while (m_queue.try_pop(entry))
+        {
+            if (entry.task)
+            {
+                entry.task();
+            }
+        }
+
+        // Blocked producers give up now, wait until they left the mutex.
+        while (m_blocked.load())
+        {
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lg(m_space_mtx);
+    }
+
+    // Called with m_threads_mtx held. The worker takes the lowest free slot,
+    // its placement index, so a worker replacing a retired one gets the CPU
+    // that one had. The worker only starts taking tasks once it is placed, if
+    // placement fails it is joined and the error is thrown. False when every
+    // slot is still held by a retiring worker.
+    bool start_thread()
+    {
+        auto slot = std::find(m_slots.begin(), m_slots.end(), false);
+        if (slot == m_slots.end())
+        {
+            return false;
+        }
+        size_t index = slot - m_slots.begin();
+
+        std::promise<bool> placed;
+        m_threads.emplace_back([this, index, go = placed.get_future()]() mutable {
+                if (go.get())
+                {
+                    worker(index);
+                }
+            });
+
+        try
+        {
+            m_placement.apply(m_threads.back(), index);
+        }
+        catch (...)
+        {
+            placed.set_value(false);
+            m_threads.back().join();
+            m_threads.pop_back();
+            throw;
+        }
+
+        *slot = true;
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        placed.set_value(true);
+        return true;
+    }
+
+    void spawn()
+    {
+        std::unique_lock<std::mutex> lg(m_threads_mtx);
+        start_thread();
+    }
+
+    void grow()
+    {
+        std::unique_lock<std::mutex> lg(m_threads_mtx, std::try_to_lock);
+        if (!lg.owns_lock() || !m_is_running || m_size.load(std::memory_order_relaxed) >= m_max_size)
+        {
+            return;
+        }
+
+        // Gives the new worker time to take tasks before growing again.
+        m_last_pop.store(now(), std::memory_order_relaxed);
+        try
+        {
+            if (start_thread())
+            {
+                m_grown.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        catch (...)
+        {
+            // No thread could be started or placed, none was added, the pool
+            // keeps running with the workers it has.
+        }
+    }
+
+    // Moves the calling worker's thread to m_retired so it is joined by the
+    // next worker to retire or by stop(), joining the one retired before.
+    // Frees the worker's slot.
+    void retire(size_t p_slot)
+    {
+        std::unique_lock<std::mutex> lg(m_threads_mtx);
+        m_slots[p_slot] = false;
+        for (auto& i : m_retired)
+        {
+            i.join();
+        }
+        m_retired.clear();
+
+        auto self = std::find_if(m_threads.begin(), m_threads.end(), [](const std::thread& p_thread) {
+                return p_thread.get_id() == std::this_thread::get_id();
+            });
+        if (self != m_threads.end())
+        {
+            m_retired.emplace_back(std::move(*self));
+            m_threads.erase(self);
+        }
+        m_retired_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void worker(size_t p_slot)
+    {
+        entry_t entry;
+        while (true)
+        {
+            if (!m_queue.try_pop(entry) && !spin(entry) && !park(entry))
+            {
+                break;
+            }
+
+            // Left by a producer whose task threw while being queued.
+            if (!entry.task)
+            {
+                continue;
+            }
+
+            if (m_elastic)
+            {
+                auto popped = now();
+                m_last_pop.store(popped, std::memory_order_relaxed);
+                if (popped - entry.queued_at > m_grow_after && !m_parked.load(std::memory_order_relaxed))
+                {
+                    grow();
+                }
+            }
+
+            // Blocked producers wait for half the queue to drain, not for
+            // every single slot.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_blocked.load(std::memory_order_relaxed) && m_queue.size() <= m_queue.capacity() / 2)
+            {
+                std::unique_lock<std::mutex> lg(m_space_mtx);
+                m_space_cv.notify_one();
+            }
+
+            m_active.fetch_add(1, std::memory_order_relaxed);
+            entry.task();
+            entry.task = {};
+            m_active.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        if (m_is_running)
+        {
+            retire(p_slot);
+        }
+    }
+
+    // Polls the queue as the idle policy says before the worker parks,
+    // producers do not notify meanwhile.
+    bool spin(entry_t& p_entry)
+    {
+        if (!m_idle.spin && !m_idle.yield)
+        {
+            return false;
+        }
+
+        m_spinning.fetch_add(1, std::memory_order_relaxed);
+        auto rv = m_idle.wait([&](){return m_queue.try_pop(p_entry);});
+        m_spinning.fetch_sub(1, std::memory_order_relaxed);
+        return rv;
+    }
+
+    // Waits for a task. False once the pool stops and the queue is drained,
+    // or when an elastic pool's worker idled out and may retire.
+    bool park(entry_t& p_entry)
+    {
+        std::unique_lock<std::mutex> lg(m_park_mtx);
+        m_parked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool rv = false;
+        auto ready = [&](){
+                rv = m_queue.try_pop(p_entry);
+                return rv || !m_is_running;
+            };
+
+        if (!m_elastic)
+        {
+            m_work_cv.wait(lg, ready);
+        }
+        else
+        {
+            while (!m_work_cv.wait_for(lg, m_idle_timeout, ready) && !try_shrink());
+        }
+        m_parked.fetch_sub(1);
+        return rv;
+    }
+
+    bool try_shrink()
+    {
+        auto size = m_size.load(std::memory_order_relaxed);
+        while (size > m_min_size)
+        {
+            if (m_size.compare_exchange_weak(size, size - 1, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::atomic<bool> m_is_running = true;
+    const size_t m_min_size;
+    const size_t m_max_size;
+    const bool m_elastic;
+    const int64_t m_grow_after;
+    const std::chrono::milliseconds m_idle_timeout;
+    const overflow_policy m_overflow;
+    const thread_placement m_placement;
+    const idle_policy m_idle;
+    mpmc_queue<entry_t> m_queue;
+
+    std::mutex m_threads_mtx;
+    std::vector<std::thread> m_threads;
+    std::vector<std::thread> m_retired;
+    std::vector<bool> m_slots;
+    std::atomic<size_t> m_size{0};
+    std::atomic<size_t> m_grown{0};
+    std::atomic<size_t> m_retired_count{0};
+    alignas(64) std::atomic<int64_t> m_last_pop;
+
+    std::atomic<size_t> m_active{0};
+    std::atomic<size_t> m_spinning{0};
+    std::atomic<size_t> m_parked{0};
+    std::mutex m_park_mtx;
+    std::condition_variable m_work_cv;
+
+    std::atomic<size_t> m_blocked{0};
+    std::mutex m_space_mtx;
+    std::condition_variable m_space_cv;
 };
 
 } // namespace bfc
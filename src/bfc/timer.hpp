@@ -2,6 +2,7 @@
 #define __BFC_TIMER_HPP__
 
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <chrono>
 #include <mutex>
@@ -13,25 +14,40 @@
 namespace bfc
 {
 
-template <typename cb_t = std::function<void()>>
+// The timer map nodes are allocated with allocator_t rebound to the node
+// type, e.g. a std::pmr::polymorphic_allocator over a sized pool.
+template <typename cb_t = std::function<void()>, typename allocator_t = std::allocator<cb_t>>
 class timer
 {
 public:
     using timer_id_t = std::pair<int64_t, uint64_t>;
 
+    timer(const allocator_t& p_allocator = allocator_t())
+        : m_cb_map(map_allocator_t(p_allocator))
+    {}
+
     timer_id_t wait_ms(int64_t for_ms, cb_t cb,
         int64_t now_ms =
             std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::high_resolution_clock::now().time_since_epoch()).count();)
+                std::chrono::high_resolution_clock::now().time_since_epoch()).count())
     {
         std::unique_lock lg(m_cb_map_mtx);
         auto next_ms = now_ms + for_ms;
         auto timer_id = m_timer_ctr++;
         timer_id_t rv{next_ms, timer_id};
-        m_cb_map.emplace(rv, cb);
+        m_cb_map.emplace(rv, std::move(cb));
         return rv;
     }
 
+    void visit(function_ref<void(const timer_id_t&)> p_visitor)
+    {
+        std::unique_lock lg(m_cb_map_mtx);
+        for (auto& timer : m_cb_map)
+        {
+            p_visitor(timer.first);
+        }
+    }
+
     bool cancel(timer_id_t id)
     {
         std::unique_lock lg(m_cb_map_mtx);
@@ -41,7 +57,9 @@ public:
     void schedule(int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::high_resolution_clock::now().time_since_epoch()).count())
     {
-        std::list<decltype(m_cb_map)::node_type> extracted;
+        // Moving the nodes to another map with the same allocator does not
+        // allocate.
+        map_t extracted(m_cb_map.get_allocator());
         {
             std::unique_lock lg(m_cb_map_mtx);
             auto it = m_cb_map.begin();
@@ -52,7 +70,7 @@ public:
                 auto& timer = *it;
                 if (now_ms >= timer.first.first)
                 {
-                    extracted.emplace_back(m_cb_map.extract(it));
+                    extracted.insert(extracted.end(), m_cb_map.extract(it));
                     it = next;
                     continue;
                 }
@@ -62,13 +80,18 @@ public:
 
         for (auto& cb : extracted)
         {
-            cb.mapped()();
+            cb.second();
         }
     }
 
 private:
+    template <typename U>
+    using rebind_t = typename std::allocator_traits<allocator_t>::template rebind_alloc<U>;
+    using map_allocator_t = rebind_t<std::pair<const timer_id_t, cb_t>>;
+    using map_t = std::map<timer_id_t, cb_t, std::less<timer_id_t>, map_allocator_t>;
+
     uint64_t m_timer_ctr = 0;
-    std::map<timer_id_t, cb_t> m_cb_map;
+    map_t m_cb_map;
     std::mutex m_cb_map_mtx;
 };
 
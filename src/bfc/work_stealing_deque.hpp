@@ -0,0 +1,157 @@
+#ifndef __BFC_WORK_STEALING_DEQUE_HPP__
+#define __BFC_WORK_STEALING_DEQUE_HPP__
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace bfc
+{
+
+// Chase-Lev deque: the owner thread pushes and pops at the bottom without
+// contention, other threads steal from the top. T is stored in atomics so it
+// must be trivially copyable, in practice a pointer to the task. The array
+// doubles when full, arrays it outgrew are kept until destruction because a
+// thief may still be reading them.
+template <typename T>
+class work_stealing_deque
+{
+    static_assert(std::is_trivially_copyable_v<T>, "work_stealing_deque elements must be trivially copyable");
+
+public:
+    work_stealing_deque(size_t p_capacity = 256)
+    {
+        size_t capacity = 2;
+        while (capacity < p_capacity)
+        {
+            capacity *= 2;
+        }
+        m_arrays.emplace_back(std::make_unique<array_t>(capacity));
+        m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    work_stealing_deque(const work_stealing_deque&) = delete;
+    void operator=(const work_stealing_deque&) = delete;
+
+    // Owner only.
+    void push(T p_value)
+    {
+        auto bottom = m_bottom.load(std::memory_order_relaxed);
+        auto top = m_top.load(std::memory_order_acquire);
+        auto array = m_array.load(std::memory_order_relaxed);
+        if (bottom - top > int64_t(array->mask))
+        {
+            array = grow(array, top, bottom);
+        }
+        array->put(bottom, p_value);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only, takes the most recently pushed element.
+    bool pop(T& p_out)
+    {
+        auto bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        auto array = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        p_out = array->get(bottom);
+        if (top == bottom)
+        {
+            // Last element, race the thieves for it.
+            bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread, takes the oldest element. Fails when empty or when it lost
+    // a race for the element.
+    bool steal(T& p_out)
+    {
+        auto top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+        {
+            return false;
+        }
+
+        auto array = m_array.load(std::memory_order_acquire);
+        auto value = array->get(top);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return false;
+        }
+        p_out = value;
+        return true;
+    }
+
+    // Only a snapshot while other threads steal.
+    size_t size() const
+    {
+        auto bottom = m_bottom.load(std::memory_order_acquire);
+        auto top = m_top.load(std::memory_order_acquire);
+        return bottom > top ? bottom - top : 0;
+    }
+
+    bool empty() const
+    {
+        return 0 == size();
+    }
+
+private:
+    struct array_t
+    {
+        array_t(size_t p_capacity)
+            : mask(p_capacity - 1)
+            , elements(std::make_unique<std::atomic<T>[]>(p_capacity))
+        {}
+
+        T get(int64_t p_index) const
+        {
+            return elements[p_index & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t p_index, T p_value)
+        {
+            elements[p_index & mask].store(p_value, std::memory_order_relaxed);
+        }
+
+        const size_t mask;
+        std::unique_ptr<std::atomic<T>[]> elements;
+    };
+
+    array_t* grow(array_t* p_array, int64_t p_top, int64_t p_bottom)
+    {
+        m_arrays.emplace_back(std::make_unique<array_t>((p_array->mask + 1) * 2));
+        auto array = m_arrays.back().get();
+        for (auto i = p_top; i < p_bottom; i++)
+        {
+            array->put(i, p_array->get(i));
+        }
+        m_array.store(array, std::memory_order_release);
+        return array;
+    }
+
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    std::atomic<array_t*> m_array;
+    std::vector<std::unique_ptr<array_t>> m_arrays;
+};
+
+} // namespace bfc
+
+#endif // __BFC_WORK_STEALING_DEQUE_HPP__
@@ -0,0 +1,316 @@
+#ifndef __BFC_WORK_STEALING_POOL_HPP__
+#define __BFC_WORK_STEALING_POOL_HPP__
+
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+#include <bfc/function.hpp>
+#include <bfc/mpmc_queue.hpp>
+#include <bfc/object_pool.hpp>
+#include <bfc/thread_placement.hpp>
+#include <bfc/work_stealing_deque.hpp>
+
+namespace bfc
+{
+
+// Executor for fine grained and nested tasks. Every worker owns a
+// work_stealing_deque, tasks submitted from one of the pool's workers go on
+// that worker's deque and are popped back in LIFO order, tasks submitted from
+// other threads go through a bounded injection queue. A worker out of tasks
+// takes from the injection queue, then steals the oldest task of a randomly
+// picked victim, then parks. Task nodes come from an object_pool so spawning
+// does not touch the global heap.
+//
+// Tasks waiting on other tasks of the same pool should use wait_until() so
+// the worker keeps executing tasks instead of blocking. Tasks still queued
+// when the pool is destroyed are run first.
+template <typename function_t = light_function<void()>>
+class work_stealing_pool
+{
+public:
+    using fn_t = function_t;
+
+    // p_placement names the workers and sets their CPU affinity.
+    work_stealing_pool(size_t p_size = std::thread::hardware_concurrency(), size_t p_queue_size = 1024,
+        const thread_placement& p_placement = {})
+        : m_injected(p_queue_size)
+    {
+        p_size = std::max(p_size, size_t(1));
+        for (size_t i=0; i<p_size; i++)
+        {
+            m_workers.emplace_back(std::make_unique<worker_t>(*this, i));
+        }
+
+        // Workers steal from each other, all must exist and be placed before
+        // any runs. If one cannot be started or placed none runs.
+        std::promise<bool> placed;
+        std::shared_future<bool> go = placed.get_future().share();
+        try
+        {
+            for (auto& i : m_workers)
+            {
+                i->thread = std::thread([this, go, worker = i.get()]() {
+                        if (go.get())
+                        {
+                            run(*worker);
+                        }
+                    });
+                p_placement.apply(i->thread, i->index);
+            }
+        }
+        catch (...)
+        {
+            placed.set_value(false);
+            stop();
+            throw;
+        }
+        placed.set_value(true);
+    }
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    void operator=(const work_stealing_pool&) = delete;
+
+    ~work_stealing_pool()
+    {
+        stop();
+    }
+
+    // Never blocks on the workers. A thread outside the pool that finds the
+    // injection queue full runs queued tasks itself until there is room.
+    template <typename callable_t>
+    void execute(callable_t&& p_functor)
+    {
+        auto task = m_tasks.construct(std::forward<callable_t>(p_functor));
+        auto worker = current();
+        if (worker)
+        {
+            worker->deque.push(task);
+        }
+        else
+        {
+            task_t* queued;
+            while (!m_injected.try_emplace(task))
+            {
+                if (m_injected.try_pop(queued))
+                {
+                    run_task(queued);
+                }
+            }
+        }
+        wake();
+    }
+
+    // Returns once p_done() is true. On one of the pool's workers the
+    // pending tasks are executed meanwhile, elsewhere the thread yields.
+    template <typename predicate_t>
+    void wait_until(predicate_t&& p_done)
+    {
+        auto worker = current();
+        task_t* task;
+        while (!p_done())
+        {
+            if (worker && find(*worker, task))
+            {
+                run_task(task);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // True on the pool's own worker threads.
+    bool in_worker() const
+    {
+        return nullptr != current();
+    }
+
+    size_t size() const
+    {
+        return m_workers.size();
+    }
+
+private:
+    struct task_t
+    {
+        template <typename callable_t>
+        task_t(callable_t&& p_functor)
+            : functor(std::forward<callable_t>(p_functor))
+        {}
+
+        function_t functor;
+    };
+
+    struct alignas(64) worker_t
+    {
+        worker_t(work_stealing_pool& p_pool, size_t p_index)
+            : pool(p_pool)
+            , index(p_index)
+            , seed(0x9E3779B97F4A7C15ull * (p_index + 1))
+        {}
+
+        work_stealing_pool& pool;
+        const size_t index;
+        uint64_t seed;
+        work_stealing_deque<task_t*> deque;
+        std::thread thread;
+    };
+
+    void stop()
+    {
+        {
+            std::unique_lock<std::mutex> lg(m_park_mtx);
+            m_is_running = false;
+            m_epoch++;
+        }
+        m_work_cv.notify_all();
+
+        for (auto& i : m_workers)
+        {
+            if (i->thread.joinable())
+            {
+                i->thread.join();
+            }
+        }
+    }
+
+    worker_t* current() const
+    {
+        auto worker = t_worker;
+        return worker && &worker->pool == this ? worker : nullptr;
+    }
+
+    void run(worker_t& p_worker)
+    {
+        t_worker = &p_worker;
+        task_t* task;
+        while (true)
+        {
+            if (find(p_worker, task))
+            {
+                run_task(task);
+            }
+            else if (!park())
+            {
+                break;
+            }
+        }
+        t_worker = nullptr;
+    }
+
+    void run_task(task_t* p_task)
+    {
+        p_task->functor();
+        m_tasks.destroy(p_task);
+    }
+
+    bool find(worker_t& p_worker, task_t*& p_task)
+    {
+        return p_worker.deque.pop(p_task) || m_injected.try_pop(p_task) || steal(p_worker, p_task);
+    }
+
+    bool steal(worker_t& p_worker, task_t*& p_task)
+    {
+        auto count = m_workers.size();
+        if (count < 2)
+        {
+            return false;
+        }
+
+        // xorshift64
+        auto& seed = p_worker.seed;
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+
+        auto start = seed % count;
+        for (size_t i=0; i<count; i++)
+        {
+            auto& victim = *m_workers[(start + i) % count];
+            if (&victim != &p_worker && victim.deque.steal(p_task))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool has_work() const
+    {
+        if (!m_injected.empty())
+        {
+            return true;
+        }
+        for (auto& i : m_workers)
+        {
+            if (!i->deque.empty())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Sleeps until new work is announced, false once the pool stops and
+    // there is no work left.
+    bool park()
+    {
+        std::unique_lock<std::mutex> lg(m_park_mtx);
+        auto epoch = m_epoch;
+        m_parked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool rv = true;
+        if (!has_work())
+        {
+            if (m_is_running)
+            {
+                m_work_cv.wait(lg, [&](){return epoch != m_epoch;});
+            }
+            else
+            {
+                rv = false;
+            }
+        }
+        m_parked.fetch_sub(1);
+        return rv;
+    }
+
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_parked.load(std::memory_order_relaxed))
+        {
+            {
+                std::unique_lock<std::mutex> lg(m_park_mtx);
+                m_epoch++;
+            }
+            m_work_cv.notify_one();
+        }
+    }
+
+    static inline thread_local worker_t* t_worker = nullptr;
+
+    object_pool<task_t> m_tasks;
+    mpmc_queue<task_t*> m_injected;
+    std::vector<std::unique_ptr<worker_t>> m_workers;
+
+    std::atomic<size_t> m_parked{0};
+    std::mutex m_park_mtx;
+    std::condition_variable m_work_cv;
+    uint64_t m_epoch = 0;
+    bool m_is_running = true;
+};
+
+} // namespace bfc
+
+#endif // __BFC_WORK_STEALING_POOL_HPP__
@@ -77,6 +77,39 @@ TEST(cv_reactor, eq_blocking_mt)
     printf("tput: %lf\n", tput);
 }
 
+TEST(cv_reactor, eq_blocking_mt_visit)
+{
+    event_queue_t q;
+    std::thread writer = std::thread([&q](){
+            for (uint64_t i=0; i<N; i++)
+            {
+                q.push(i);
+            }
+        });
+
+    auto t_start = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    uint64_t n = 0;
+    uint64_t expected = 0;
+    while (n < N)
+    {
+        n += q.pop([&expected](uint64_t& i){
+                ASSERT_EQ(expected, i);
+                expected++;
+            });
+    }
+    auto t_end = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+
+    ASSERT_EQ(n, N);
+
+    writer.join();
+
+    auto t_diff = (t_end - t_start);
+    auto tput = double(N) * 1000 * 1000 * 1000 / t_diff;
+    tput /= 1000000;
+
+    printf("tput: %lf\n", tput);
+}
+
 TEST(cv_reactor, eq_nonblocking_mt)
 {
     event_queue_t q{false};
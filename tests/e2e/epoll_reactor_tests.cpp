@@ -337,3 +337,31 @@ TEST(epoll_reactor, reactive)
     printf("counters.recv: %zu\n", ctrs.server_read);
     printf("tput: %lf\n", tput);
 }
+
+TEST(epoll_reactor, wake_up_mt)
+{
+    reactor_t reactor;
+    uint64_t called = 0;
+
+    std::thread poster = std::thread([&](){
+        for (uint64_t i=0; i < N; i++)
+        {
+            reactor.wake_up([&called](){called++;});
+        }
+        reactor.wake_up([&reactor](){reactor.stop();});
+    });
+
+    auto t_start = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    reactor.run();
+    auto t_end = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+
+    poster.join();
+
+    EXPECT_EQ(N, called);
+
+    auto t_diff = (t_end - t_start);
+    auto tput = double(N) * 1000 * 1000 * 1000 / t_diff;
+    tput /= 1000000;
+
+    printf("tput: %lf\n", tput);
+}
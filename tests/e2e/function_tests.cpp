@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <bfc/function.hpp>
+
+#include <chrono>
+#include <functional>
+
+using namespace bfc;
+
+// The previous bfc::function layout: four function pointers per object and
+// an unaligned inline buffer, kept here as the benchmark baseline.
+template <size_t N, typename return_t, typename... args_t>
+class legacy_function
+{
+public:
+    legacy_function() = default;
+
+    legacy_function(legacy_function &&p_other)
+    {
+        if (p_other.m_fn)
+        {
+            p_other.m_mover(m_object, p_other.m_object);
+        }
+
+        set(p_other);
+        p_other.m_fn = nullptr;
+    }
+
+    template <typename callable_t, std::enable_if_t<!std::is_same_v<std::decay_t<callable_t>, legacy_function>> *p = nullptr>
+    legacy_function(callable_t &&p_obj)
+    {
+        using callable_tType = std::decay_t<callable_t>;
+        static_assert(N >= sizeof(callable_tType));
+        new (m_object) callable_tType(std::forward<callable_t>(p_obj));
+        m_destroyer = [](void *p_obj) {
+            ((callable_tType *)p_obj)->~callable_tType();
+        };
+
+        m_copier = [](void *p_obj, const void *p_other) {
+            new (p_obj) callable_tType(*(const callable_tType *)p_other);
+        };
+
+        m_mover = [](void *p_obj, void *p_other) {
+            new (p_obj) callable_tType(std::move(*(callable_tType *)p_other));
+        };
+
+        m_fn = [](const void *p_obj, args_t... pArgs) -> return_t {
+            return (*((callable_tType *)p_obj))(std::forward<args_t>(pArgs)...);
+        };
+    }
+
+    legacy_function &operator=(legacy_function &&p_other)
+    {
+        if (m_fn)
+        {
+            m_destroyer(m_object);
+        }
+
+        if (p_other.m_fn)
+        {
+            p_other.m_mover(m_object, p_other.m_object);
+        }
+
+        set(p_other);
+        p_other.m_fn = nullptr;
+        return *this;
+    }
+
+    ~legacy_function()
+    {
+        if (m_fn)
+        {
+            m_destroyer(m_object);
+        }
+    }
+
+    return_t operator()(args_t... pArgs) const
+    {
+        return m_fn(m_object, std::forward<args_t>(pArgs)...);
+    }
+
+private:
+    void set(const legacy_function &p_other)
+    {
+        m_fn = p_other.m_fn;
+        m_destroyer = p_other.m_destroyer;
+        m_copier = p_other.m_copier;
+        m_mover = p_other.m_mover;
+    }
+
+    std::byte m_object[N];
+    return_t (*m_fn)(const void *, args_t...) = nullptr;
+    void (*m_destroyer)(void *) = nullptr;
+    void (*m_copier)(void *, const void *) = nullptr;
+    void (*m_mover)(void *, void *) = nullptr;
+};
+
+constexpr uint64_t N = 10000000;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+template <typename fn_t>
+void bench(const char* name)
+{
+    uint64_t a = 0;
+    uint64_t b = 1;
+    uint64_t* pa = &a;
+    fn_t fns[2];
+    fns[0] = fn_t([pa, &b](uint64_t i) -> uint64_t {return *pa += i + b;});
+
+    auto t_start = now_ns();
+    uint64_t res = 0;
+    for (uint64_t i=0; i<N; i++)
+    {
+        res += fns[0](i);
+    }
+    auto t_invoke = now_ns() - t_start;
+
+    t_start = now_ns();
+    for (uint64_t i=0; i<N; i++)
+    {
+        fns[(i+1)&1] = std::move(fns[i&1]);
+    }
+    auto t_move = now_ns() - t_start;
+
+    EXPECT_NE(0u, res + fns[N&1](0));
+    printf("%-16s sizeof: %2zu invoke_ns: %lf move_ns: %lf\n", name, sizeof(fn_t),
+        double(t_invoke)/N, double(t_move)/N);
+}
+
+TEST(function, bench_invoke_and_move)
+{
+    bench<light_function<uint64_t(uint64_t)>>("light_function");
+    bench<legacy_function<24, uint64_t, uint64_t>>("legacy_function");
+    bench<std::function<uint64_t(uint64_t)>>("std::function");
+}
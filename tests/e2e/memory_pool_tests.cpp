@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <bfc/memory_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace bfc;
+
+constexpr uint64_t N = 2000000;
+constexpr size_t BURST = 16;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// Each thread allocates and frees bursts of packet sized blocks, returns
+// the aggregate million allocations per second.
+static double bench(size_t p_threads, size_t p_thread_cache)
+{
+    sized_memory_pool<> pool(1500, {}, p_thread_cache);
+    std::vector<std::thread> threads;
+
+    auto t_start = now_ns();
+    for (size_t t = 0; t < p_threads; t++)
+    {
+        threads.emplace_back([&pool]() {
+                std::byte* blocks[BURST];
+                for (uint64_t i = 0; i < N; i += BURST)
+                {
+                    for (auto& block : blocks)
+                    {
+                        block = pool.allocate_raw();
+                        *block = std::byte(i);
+                    }
+                    for (auto block : blocks)
+                    {
+                        pool.free(block);
+                    }
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    auto t_total = now_ns() - t_start;
+
+    return double(N * p_threads) * 1000 / t_total;
+}
+
+TEST(memory_pool, bench_thread_cache_scaling)
+{
+    size_t max_threads = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        auto locked = bench(threads, 0);
+        auto cached = bench(threads, sized_memory_pool<>::default_thread_cache);
+        printf("threads: %zu locked_mops: %lf magazine_mops: %lf\n", threads, locked, cached);
+    }
+}
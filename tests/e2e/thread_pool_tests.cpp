@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include <bfc/thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace bfc;
+
+constexpr size_t TASKS = 500000;
+constexpr size_t BATCH = 500;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// Submits batches of trivial tasks the way a reactor iteration would, returns
+// million tasks per second from first submission to last completion.
+static double bench(size_t p_threads, bool p_bulk)
+{
+    thead_pool<> pool(p_threads, BATCH * 4);
+    std::atomic<size_t> done = 0;
+    std::vector<thead_pool<>::fn_t> batch(BATCH, [&done](){done.fetch_add(1, std::memory_order_relaxed);});
+
+    auto t_start = now_ns();
+    for (size_t i = 0; i < TASKS; i += BATCH)
+    {
+        if (p_bulk)
+        {
+            pool.execute_bulk(batch.begin(), batch.end());
+        }
+        else
+        {
+            for (auto& task : batch)
+            {
+                pool.execute(task);
+            }
+        }
+    }
+    while (done.load() < TASKS)
+    {
+        std::this_thread::yield();
+    }
+    auto t_total = now_ns() - t_start;
+
+    return double(TASKS) * 1000 / t_total;
+}
+
+TEST(thead_pool, bench_bulk_submission)
+{
+    size_t max_threads = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        auto single = bench(threads, false);
+        auto bulk = bench(threads, true);
+        printf("threads: %zu per_task_mtps: %lf bulk_mtps: %lf\n", threads, single, bulk);
+    }
+}
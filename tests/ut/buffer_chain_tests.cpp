@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+#include <bfc/buffer_chain.hpp>
+#include <bfc/socket.hpp>
+
+using namespace bfc;
+
+TEST(buffer_chain, ShouldGatherSegments)
+{
+    std::byte header[4]{};
+    buffer payload(new std::byte[16], 16);
+    buffer_chain chain(buffer_view(header, sizeof(header)), payload);
+    EXPECT_EQ(2u, chain.count());
+    EXPECT_EQ(20u, chain.size());
+    EXPECT_EQ(header, chain[0].data());
+    EXPECT_EQ(payload.data(), chain.iov()[1].iov_base);
+}
+
+TEST(buffer_chain, ShouldConsumePartialPrefix)
+{
+    char a[] = "0123";
+    char b[] = "4567";
+    char c[] = "89";
+    buffer_chain<4> chain;
+    chain.push_back(a, 4);
+    chain.push_back(b, 4);
+    chain.push_back(c, 2);
+
+    EXPECT_EQ(8u, chain.consume(2));
+    EXPECT_EQ(3u, chain.count());
+    EXPECT_EQ((std::byte*) a + 2, chain[0].data());
+
+    EXPECT_EQ(4u, chain.consume(4));
+    EXPECT_EQ(2u, chain.count());
+    EXPECT_EQ((std::byte*) b + 2, chain[0].data());
+    EXPECT_EQ(2u, chain[0].size());
+
+    EXPECT_EQ(0u, chain.consume(4));
+    EXPECT_TRUE(chain.empty());
+    EXPECT_EQ(0u, chain.count());
+}
+
+TEST(buffer_chain, ShouldThrowWhenFull)
+{
+    char a[1];
+    buffer_chain<1> chain;
+    chain.push_back(a, 1);
+    EXPECT_THROW(chain.push_back(a, 1), std::length_error);
+}
+
+TEST(buffer_chain, ShouldSendAndReceiveInOneCall)
+{
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    bfc::socket tx(fds[0]);
+    bfc::socket rx(fds[1]);
+
+    std::string header = "HDR:";
+    std::string body = "payload";
+    ASSERT_EQ(11, tx.send(buffer_chain(buffer_view(header.data(), header.size()), buffer_view(body.data(), body.size()))));
+
+    char rx_header[4];
+    char rx_body[7];
+    buffer_chain<2> rx_chain;
+    rx_chain.push_back(rx_header, sizeof(rx_header));
+    rx_chain.push_back(rx_body, sizeof(rx_body));
+    ASSERT_EQ(11, rx.recv(rx_chain, 0));
+    EXPECT_EQ(0, std::memcmp(rx_header, "HDR:", 4));
+    EXPECT_EQ(0, std::memcmp(rx_body, "payload", 7));
+}
+
+TEST(buffer_chain, ShouldReceiveIntoTemporaryChain)
+{
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    bfc::socket tx(fds[0]);
+    bfc::socket rx(fds[1]);
+
+    std::string data = "HDR:payload";
+    ASSERT_EQ(11, tx.send(buffer_view(data.data(), data.size())));
+
+    char rx_header[4];
+    char rx_body[7];
+    ASSERT_EQ(11, rx.recv(buffer_chain<2>(buffer_view(rx_header, sizeof(rx_header)), buffer_view(rx_body, sizeof(rx_body))), 0));
+    EXPECT_EQ(0, std::memcmp(rx_header, "HDR:", 4));
+    EXPECT_EQ(0, std::memcmp(rx_body, "payload", 7));
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <bfc/callback_arena.hpp>
+
+using namespace bfc;
+
+TEST(callback_arena, ShouldInvokeInOrderAndClear)
+{
+    callback_arena<void(std::vector<int>&)> arena;
+    std::array<int, 32> big{};
+    big[31] = 3;
+
+    arena.emplace([](std::vector<int>& v){v.emplace_back(1);});
+    arena.emplace([big](std::vector<int>& v){v.emplace_back(big[31]-1);});
+    arena.emplace([u = std::make_unique<int>(3)](std::vector<int>& v){v.emplace_back(*u);});
+    EXPECT_EQ(3u, arena.size());
+
+    std::vector<int> called;
+    arena.invoke_and_clear(called);
+    EXPECT_EQ((std::vector<int>{1,2,3}), called);
+    EXPECT_TRUE(arena.empty());
+
+    arena.invoke_and_clear(called);
+    EXPECT_EQ(3u, called.size());
+}
+
+TEST(callback_arena, ShouldSpanChunks)
+{
+    callback_arena<void(), 128> arena;
+    std::array<uint64_t, 40> big{};
+    uint64_t sum = 0;
+    for (uint64_t i=0; i<100; i++)
+    {
+        big[0] = i;
+        if (i%10)
+        {
+            arena.emplace([&sum, i](){sum += i;});
+        }
+        else
+        {
+            arena.emplace([&sum, big](){sum += big[0];});
+        }
+    }
+
+    arena.invoke_and_clear();
+    EXPECT_EQ(4950u, sum);
+
+    arena.emplace([&sum](){sum = 0;});
+    arena.invoke_and_clear();
+    EXPECT_EQ(0u, sum);
+}
+
+TEST(callback_arena, ShouldDestroyWithoutInvoking)
+{
+    auto counter = std::make_shared<int>(0);
+    int called = 0;
+    {
+        callback_arena<void()> arena;
+        arena.emplace([counter, &called](){called++;});
+        arena.emplace([counter, &called](){called++;});
+        EXPECT_EQ(3, counter.use_count());
+    }
+    EXPECT_EQ(1, counter.use_count());
+    EXPECT_EQ(0, called);
+}
+
+TEST(callback_arena, ShouldClearOnThrow)
+{
+    auto counter = std::make_shared<int>(0);
+    callback_arena<void()> arena;
+    arena.emplace([counter](){throw std::runtime_error("cb");});
+    arena.emplace([counter](){});
+    EXPECT_THROW(arena.invoke_and_clear(), std::runtime_error);
+    EXPECT_TRUE(arena.empty());
+    EXPECT_EQ(1, counter.use_count());
+}
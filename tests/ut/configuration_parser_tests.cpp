@@ -18,3 +18,26 @@ TEST(configuration_parser, shoulParseConfig)
     EXPECT_FALSE(parser.arg("key31"));
     EXPECT_FALSE(parser.as<int>("key3"));
 }
+
+static size_t count_keys(std::map<std::string, std::string>& p_map)
+{
+    return p_map.size();
+}
+
+TEST(configuration_parser, shouldStayAPlainStringMap)
+{
+    static_assert(std::is_base_of_v<std::map<std::string, std::string>, args_map>);
+    configuration_parser parser;
+    parser.load_line("key1 = 1234");
+    EXPECT_EQ(1u, count_keys(parser));
+}
+
+TEST(configuration_parser, shouldLookUpTransparently)
+{
+    transparent_args_map args;
+    args.emplace("key1", "1234");
+    std::string_view key("key12", 4);
+    EXPECT_EQ(1234, args.as<int>(key));
+    EXPECT_NE(args.end(), args.find(key));
+    EXPECT_FALSE(args.arg("key"));
+}
@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include <bfc/event_queue.hpp>
+#include <bfc/epoll_reactor.hpp>
+
+using namespace bfc;
+
+// Pushes 1, 2, 3, pops with a visitor throwing on 2, pushes 4 and expects
+// only 4 on the next pops.
+template <typename queue_t>
+static void check_throwing_visitor(queue_t& p_queue)
+{
+    for (int i=1; i<=3; i++)
+    {
+        p_queue.push(i);
+    }
+
+    std::vector<int> seen;
+    EXPECT_THROW(p_queue.pop([&seen](int& p_value) {
+            if (2 == p_value)
+            {
+                throw std::runtime_error("visit");
+            }
+            seen.push_back(p_value);
+        }), std::runtime_error);
+    EXPECT_EQ((std::vector<int>{1}), seen);
+
+    p_queue.push(4);
+    seen.clear();
+    EXPECT_EQ(1u, p_queue.pop([&seen](int& p_value){seen.push_back(p_value);}));
+    EXPECT_EQ((std::vector<int>{4}), seen);
+    EXPECT_EQ(0u, p_queue.pop([&seen](int& p_value){seen.push_back(p_value);}));
+}
+
+TEST(event_queue, ShouldNotRedeliverAfterThrowingVisitor)
+{
+    event_queue<int> queue(false);
+    check_throwing_visitor(queue);
+}
+
+TEST(reactive_event_queue, ShouldNotRedeliverAfterThrowingVisitor)
+{
+    reactive_event_queue<int, epoll_reactor<>> queue;
+    check_throwing_visitor(queue);
+}
@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <array>
+#include <memory>
+
 #include <bfc/function.hpp>
 
 using namespace bfc;
@@ -171,3 +174,177 @@ TEST(FixedFunctionObject, ShouldAssignFromStaticMember)
 
     EXPECT_EQ(0, TestClass::count);
 }
+
+struct counting_spill
+{
+    static int allocated;
+    static void* allocate(size_t p_size)
+    {
+        allocated++;
+        return heap_spill::allocate(p_size);
+    }
+
+    static void deallocate(void* p_ptr, size_t p_size)
+    {
+        allocated--;
+        heap_spill::deallocate(p_ptr, p_size);
+    }
+};
+
+int counting_spill::allocated = 0;
+
+TEST(FixedFunctionObject, ShouldKeepSmallCallableInline)
+{
+    counting_spill::allocated = 0;
+    TestClass tc;
+    light_function<int(int), counting_spill> fn([&tc](int i)->int {return tc.increment(i);});
+    EXPECT_EQ(42, fn(41));
+    EXPECT_EQ(0, counting_spill::allocated);
+}
+
+TEST(FixedFunctionObject, ShouldSpillOversizedCallable)
+{
+    counting_spill::allocated = 0;
+    TestClass::reset();
+    {
+        std::array<int, 16> data{};
+        data[15] = 41;
+        light_function<int(), counting_spill> fn([data, tc = TestClass()]() mutable -> int {return tc.increment(data[15]);});
+        EXPECT_EQ(1, counting_spill::allocated);
+        EXPECT_EQ(42, fn());
+
+        auto fn2 = fn;
+        EXPECT_EQ(2, counting_spill::allocated);
+        EXPECT_EQ(42, fn2());
+
+        auto fn3 = std::move(fn);
+        EXPECT_EQ(2, counting_spill::allocated);
+        EXPECT_EQ(42, fn3());
+        EXPECT_THROW(fn(), std::bad_function_call);
+
+        fn2 = nullptr;
+        EXPECT_EQ(1, counting_spill::allocated);
+    }
+    EXPECT_EQ(0, counting_spill::allocated);
+    EXPECT_EQ(0, TestClass::count);
+}
+
+TEST(FixedFunctionObject, ShouldHoldMoveOnlyCallable)
+{
+    auto value = std::make_unique<int>(41);
+    unique_light_function<int()> fn([value = std::move(value)]() -> int {return *value + 1;});
+    unique_light_function<int()> fn2(std::move(fn));
+    EXPECT_EQ(42, fn2());
+    EXPECT_THROW(fn(), std::bad_function_call);
+    EXPECT_FALSE(std::is_copy_constructible_v<unique_light_function<int()>>);
+    EXPECT_FALSE(std::is_copy_assignable_v<unique_light_function<int()>>);
+}
+
+TEST(FixedFunctionObject, ShouldDestructMoveOnlyCallable)
+{
+    TestClass::reset();
+    {
+        unique_light_function<void()> fn{TestClass()};
+        unique_light_function<void()> fn2;
+        fn2 = std::move(fn);
+        fn2();
+        EXPECT_EQ(1, TestClass::count);
+        EXPECT_EQ(1, TestClass::called);
+    }
+    EXPECT_EQ(0, TestClass::count);
+}
+
+TEST(FixedFunctionObject, ShouldHaveOnePointerOverhead)
+{
+    EXPECT_EQ(8u + sizeof(void*), sizeof(ulight_function<void()>));
+    EXPECT_EQ(24u + sizeof(void*), sizeof(light_function<void()>));
+    EXPECT_EQ(24u + sizeof(void*), sizeof(unique_light_function<void()>));
+    // Padded to the fundamental alignment.
+    EXPECT_EQ(48u, sizeof(big_function<void()>));
+    EXPECT_EQ(alignof(std::max_align_t), alignof(light_function<void()>));
+}
+
+TEST(FixedFunctionObject, ShouldHoldFundamentallyAlignedCallableInline)
+{
+    long double value = 4.5;
+    light_function<long double()> fn([value]() {
+            EXPECT_EQ(0u, uintptr_t(&value) % alignof(long double));
+            return value * 2;
+        });
+    light_function<long double()> fn2(fn);
+    light_function<long double()> fn3(std::move(fn));
+    EXPECT_EQ(9.0L, fn2());
+    EXPECT_EQ(9.0L, fn3());
+}
+
+TEST(FixedFunctionObject, ShouldAlignInlineCallable)
+{
+    struct callable
+    {
+        char c;
+        double d;
+        double operator()() const
+        {
+            EXPECT_EQ(0u, uintptr_t(&d) % alignof(double));
+            return d;
+        }
+    };
+
+    callable c{'a', 4.2};
+    light_function<double()> fn(c);
+    light_function<double()> fn2(fn);
+    light_function<double()> fn3(std::move(fn));
+    EXPECT_EQ(4.2, fn2());
+    EXPECT_EQ(4.2, fn3());
+}
+
+TEST(FixedFunctionObject, ShouldCopyTrivialCallable)
+{
+    int a = 40;
+    int b = 2;
+    light_function<int()> fn([&a, &b](){return a + b;});
+    light_function<int()> fn2(fn);
+    light_function<int()> fn3;
+    fn3 = std::move(fn);
+    EXPECT_EQ(42, fn2());
+    EXPECT_EQ(42, fn3());
+    EXPECT_THROW(fn(), std::bad_function_call);
+}
+
+TEST(function_ref, ShouldCallLambda)
+{
+    int a = 41;
+    std::array<int, 64> big{};
+    auto lambda = [&a, big](int b) {return a + b + big[0];};
+    function_ref<int(int)> fn(lambda);
+    EXPECT_EQ(42, fn(1));
+    EXPECT_EQ(2 * sizeof(void*), sizeof(fn));
+}
+
+TEST(function_ref, ShouldCallNonMemberFunction)
+{
+    function_ref<int(int)> fn(increment);
+    function_ref<int(int)> fn2(&increment);
+    EXPECT_EQ(42, fn(41));
+    EXPECT_EQ(42, fn2(41));
+}
+
+TEST(function_ref, ShouldBeEmptyFromEmptyFunction)
+{
+    light_function<void()> empty;
+    function_ref<void()> fn(empty);
+    function_ref<void()> fn2(nullptr);
+    EXPECT_FALSE(fn);
+    EXPECT_FALSE(fn2);
+    EXPECT_THROW(fn(), std::bad_function_call);
+}
+
+TEST(function_ref, ShouldReferenceFunction)
+{
+    TestClass::reset();
+    light_function<void()> owner{TestClass()};
+    function_ref<void()> fn(owner);
+    fn();
+    EXPECT_EQ(1, TestClass::called);
+    EXPECT_EQ(0, TestClass::copy);
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <bfc/epoll_reactor.hpp>
+#include <bfc/future.hpp>
+#include <bfc/thread_pool.hpp>
+
+using namespace bfc;
+
+TEST(future, ShouldGetSubmittedResult)
+{
+    thead_pool<> pool(2);
+    auto value = pool.submit([](){return std::string("result");});
+    EXPECT_TRUE(value.valid());
+    EXPECT_EQ("result", value.get());
+    EXPECT_FALSE(value.valid());
+
+    bool ran = false;
+    auto done = pool.submit([&ran](){ran = true;});
+    done.get();
+    EXPECT_TRUE(ran);
+}
+
+TEST(future, ShouldRethrowTaskException)
+{
+    thead_pool<> pool(1);
+    auto value = pool.submit([]() -> int {throw std::runtime_error("task failed");});
+    EXPECT_THROW(value.get(), std::runtime_error);
+}
+
+TEST(future, ShouldWaitForSlowTask)
+{
+    thead_pool<> pool(1);
+    auto value = pool.submit([]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            return 7;
+        });
+    EXPECT_FALSE(value.is_ready());
+    value.wait();
+    EXPECT_TRUE(value.is_ready());
+    EXPECT_EQ(7, value.get());
+}
+
+TEST(future, ShouldFailWhenQueueRejects)
+{
+    thead_pool<> pool(1, 2, overflow_policy::reject);
+    std::promise<void> gate;
+    auto blocker = pool.submit([gate = gate.get_future().share()](){gate.wait();});
+    while (!pool.count_active())
+    {
+        std::this_thread::yield();
+    }
+    auto first = pool.submit([](){return 1;});
+    auto second = pool.submit([](){return 2;});
+    auto rejected = pool.submit([](){return 3;});
+
+    EXPECT_TRUE(rejected.is_ready());
+    EXPECT_THROW(rejected.get(), std::runtime_error);
+    gate.set_value();
+    EXPECT_EQ(1, first.get());
+    EXPECT_EQ(2, second.get());
+}
+
+TEST(future, ShouldPostContinuationToReactor)
+{
+    thead_pool<unique_light_function<void()>> pool(2);
+    epoll_reactor<> reactor;
+    std::thread::id reactor_thread;
+    std::thread::id continued_on;
+    int result = 0;
+
+    reactor.wake_up([&]() {
+            reactor_thread = std::this_thread::get_id();
+            pool.submit([value = std::make_unique<int>(41)](){return *value + 1;})
+                .then(reactor, [&](future<int>&& p_result) {
+                        continued_on = std::this_thread::get_id();
+                        result = p_result.get();
+                        reactor.stop();
+                    });
+        });
+    reactor.run();
+
+    EXPECT_EQ(42, result);
+    EXPECT_EQ(reactor_thread, continued_on);
+}
+
+TEST(future, ShouldContinueWhenAlreadyReady)
+{
+    thead_pool<> pool(1);
+    epoll_reactor<> reactor;
+    auto value = pool.submit([](){return 5;});
+    value.wait();
+
+    int result = 0;
+    std::move(value).then(reactor, [&](future<int>&& p_result) {
+            result = p_result.get();
+            reactor.stop();
+        });
+    reactor.run();
+    EXPECT_EQ(5, result);
+}
+
+TEST(future, ShouldContinueWithLargeCallback)
+{
+    thead_pool<> pool(1);
+    epoll_reactor<spill_unique_big_function<void()>> reactor;
+    auto value = pool.submit([](){return 5;});
+
+    std::array<int, 16> offsets{};
+    offsets.back() = 2;
+    int result = 0;
+    std::move(value).then(reactor, [&result, &reactor, offsets](future<int>&& p_result) {
+            result = p_result.get() + offsets.back();
+            reactor.stop();
+        });
+    reactor.run();
+    EXPECT_EQ(7, result);
+}
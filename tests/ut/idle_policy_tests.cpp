@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <thread>
+
+#include <bfc/cv_reactor.hpp>
+#include <bfc/event_queue.hpp>
+#include <bfc/idle_policy.hpp>
+#include <bfc/thread_pool.hpp>
+
+using namespace bfc;
+
+TEST(idle_policy, ShouldStopWaitingWhenReady)
+{
+    idle_policy idle{1000, 10};
+    int checks = 0;
+    EXPECT_TRUE(idle.wait([&checks](){return ++checks == 3;}));
+    EXPECT_EQ(3, checks);
+
+    checks = 0;
+    EXPECT_FALSE(idle.wait([&checks](){checks++; return false;}));
+    EXPECT_EQ(1010, checks);
+
+    EXPECT_FALSE(idle_policy{}.wait([](){return true;}));
+}
+
+TEST(idle_policy, ShouldHandOffToSpinningPoolWorkers)
+{
+    thead_pool<> pool(2, 64, overflow_policy::block, {}, idle_policy{100000, 100});
+    for (int i=0; i<100; i++)
+    {
+        std::promise<int> res;
+        pool.execute([&res, i](){res.set_value(i);});
+        EXPECT_EQ(i, res.get_future().get());
+    }
+}
+
+TEST(idle_policy, ShouldHandOffToSpinningEventQueueConsumer)
+{
+    event_queue<int> queue(true, idle_policy{100000, 100});
+    std::thread consumer([&queue]() {
+            int expected = 0;
+            while (expected < 1000)
+            {
+                queue.pop([&expected](int& p_value) {
+                        EXPECT_EQ(expected, p_value);
+                        expected++;
+                    });
+            }
+        });
+
+    for (int i=0; i<1000; i++)
+    {
+        queue.push(i);
+    }
+    consumer.join();
+}
+
+TEST(idle_policy, ShouldWakeSpinningAndSleepingCvReactor)
+{
+    cv_reactor<int> reactor(1000, idle_policy{1000, 10});
+    std::atomic<int> calls = 0;
+    std::thread loop([&reactor](){reactor.run();});
+
+    reactor.wake_up([&calls](){calls++;});
+    while (calls.load() < 1)
+    {
+        std::this_thread::yield();
+    }
+
+    // Long enough for the loop to be asleep.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    reactor.wake_up([&calls](){calls++;});
+    while (calls.load() < 2)
+    {
+        std::this_thread::yield();
+    }
+
+    reactor.stop();
+    loop.join();
+}
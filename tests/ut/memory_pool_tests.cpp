@@ -1,6 +1,13 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
 #include <bfc/memory_pool.hpp>
+#include <bfc/command_manager.hpp>
 
 using namespace bfc;
 
@@ -38,3 +45,405 @@ TEST(log2_memory_pool, ShouldAllocate)
     ASSERT_NE(nullptr, pool.allocate(4097).data());
     ASSERT_NE(nullptr, pool.allocate(8193).data());
 }
+
+TEST(log2_memory_pool, ShouldPickSmallestSubClass)
+{
+    using pool_t = log2_memory_pool<alignof(std::max_align_t), heap_block_allocator, 4>;
+    EXPECT_EQ(41u, pool_t::class_count);
+    EXPECT_EQ(16u, pool_t::class_size(1));
+    EXPECT_EQ(16u, pool_t::class_size(16));
+    EXPECT_EQ(20u, pool_t::class_size(17));
+    EXPECT_EQ(40u, pool_t::class_size(33));
+    EXPECT_EQ(1280u, pool_t::class_size(1025));
+    EXPECT_EQ(16384u, pool_t::class_size(16384));
+
+    size_t previous = 0;
+    for (size_t i=1; i<=pool_t::max_size; i++)
+    {
+        auto size = pool_t::class_size(i);
+        ASSERT_LE(i, size);
+        if (i > pool_t::min_size)
+        {
+            ASSERT_GE(i + (i/4), size) << i;
+        }
+        ASSERT_LE(previous, size);
+        previous = size;
+    }
+}
+
+TEST(log2_memory_pool, ShouldFreeWithoutSize)
+{
+    log2_memory_pool<alignof(std::max_align_t), heap_block_allocator, 4> pool({}, 0);
+    for (size_t size : {1u, 100u, 1000u, 16384u})
+    {
+        auto block = pool.allocate_raw(size);
+        std::memset(block, 0xA5, size);
+        pool.free(block);
+        EXPECT_EQ(block, pool.allocate_raw(size));
+        pool.free(block);
+    }
+}
+
+TEST(log2_memory_pool, ShouldMapLargeAllocations)
+{
+    log2_memory_pool pool;
+    auto block = pool.allocate_raw(1024*1024);
+    EXPECT_EQ(0u, uintptr_t(block) % alignof(std::max_align_t));
+    std::memset(block, 0xA5, 1024*1024);
+    pool.free(block);
+
+    auto buffer = pool.allocate(20000);
+    EXPECT_EQ(20000u, buffer.size());
+    auto pooled = pool.allocate_pooled(20000);
+    std::memset(pooled.data(), 0xA5, pooled.size());
+    EXPECT_THROW(pool.free(&pool), std::invalid_argument);
+}
+
+TEST(log2_memory_pool, ShouldClearTagsOfFreedLargeAllocations)
+{
+    log2_memory_pool pool;
+    auto block = pool.allocate_raw(1024*1024);
+    auto middle = block + 512*1024;
+    EXPECT_NE(detail::segment_map::none, detail::segment_map::get(middle));
+    pool.free(block);
+    EXPECT_EQ(detail::segment_map::none, detail::segment_map::get(middle));
+}
+
+TEST(log2_memory_pool, ShouldHoldThousandsOfPools)
+{
+    std::vector<std::unique_ptr<log2_memory_pool<>>> pools;
+    for (int i=0; i<1000; i++)
+    {
+        pools.emplace_back(std::make_unique<log2_memory_pool<>>());
+    }
+    auto& last = *pools.back();
+    auto block = last.allocate_raw(100);
+    EXPECT_NE(detail::segment_map::none, detail::segment_map::get(block));
+    last.free(block);
+}
+
+TEST(log2_memory_pool, ShouldStartSmallClassesWithOnePage)
+{
+    log2_memory_pool pool;
+    pool.free(pool.allocate_raw(16));
+    pool.free(pool.allocate_raw(100));
+    auto stats = pool.stats();
+    EXPECT_EQ(4096u, stats[pool.index(16)].retained_bytes + stats[pool.index(16)].outstanding_bytes);
+    EXPECT_EQ(4096u, stats[pool.index(100)].retained_bytes + stats[pool.index(100)].outstanding_bytes);
+}
+
+TEST(sized_memory_pool, ShouldReuseFromThreadCache)
+{
+    sized_memory_pool sp(64, {}, 4);
+    auto first = sp.allocate_raw();
+    sp.free(first);
+    EXPECT_EQ(first, sp.allocate_raw());
+    sp.free(first);
+}
+
+TEST(sized_memory_pool, ShouldReturnMagazineOnThreadExit)
+{
+    sized_memory_pool sp(64, {}, 8);
+    std::vector<std::byte*> blocks;
+    std::thread([&]() {
+            for (size_t i=0; i<6; i++)
+            {
+                blocks.emplace_back(sp.allocate_raw());
+            }
+            for (auto block : blocks)
+            {
+                sp.free(block);
+            }
+        }).join();
+
+    // The exited thread's blocks went back to the depot.
+    std::vector<std::byte*> reused;
+    for (size_t i=0; i<6; i++)
+    {
+        reused.emplace_back(sp.allocate_raw());
+    }
+    std::sort(blocks.begin(), blocks.end());
+    std::sort(reused.begin(), reused.end());
+    EXPECT_EQ(blocks, reused);
+    for (auto block : reused)
+    {
+        sp.free(block);
+    }
+}
+
+TEST(sized_memory_pool, ShouldWorkWithoutThreadCache)
+{
+    sized_memory_pool sp(64, {}, 0);
+    auto first = sp.allocate_raw();
+    sp.free(first);
+    EXPECT_EQ(first, sp.allocate_raw());
+    sp.free(first);
+}
+
+TEST(sized_memory_pool, ShouldCarveContiguousBlocksOnReserve)
+{
+    sized_memory_pool sp(48, {}, 0);
+    sp.reserve(100);
+    EXPECT_EQ(100u, sp.capacity());
+    auto first = sp.allocate_raw();
+    for (size_t i=1; i<100; i++)
+    {
+        auto block = sp.allocate_raw();
+        EXPECT_EQ(first + i*48, block);
+    }
+    EXPECT_EQ(100u, sp.capacity());
+}
+
+TEST(sized_memory_pool, ShouldTrimToMaxRetained)
+{
+    sized_memory_pool sp(64, {}, 0, 8*64, 8);
+    std::vector<std::byte*> blocks;
+    for (size_t i=0; i<64; i++)
+    {
+        blocks.emplace_back(sp.allocate_raw());
+    }
+    EXPECT_LE(64u, sp.capacity());
+    for (auto block : blocks)
+    {
+        sp.free(block);
+    }
+    EXPECT_GE(16u, sp.capacity());
+
+    auto block = sp.allocate_raw();
+    sp.trim();
+    EXPECT_GE(8u, sp.capacity());
+    sp.free(block);
+    sp.trim();
+    EXPECT_EQ(0u, sp.capacity());
+}
+
+namespace
+{
+
+// Hands out p_blocks blocks, then fails.
+struct limited_allocator
+{
+    std::byte* allocate(size_t p_size, size_t p_alignment)
+    {
+        if (!blocks)
+        {
+            throw std::bad_alloc();
+        }
+        blocks--;
+        return heap_block_allocator().allocate(p_size, p_alignment);
+    }
+
+    void deallocate(std::byte* p_ptr, size_t p_size, size_t p_alignment)
+    {
+        heap_block_allocator().deallocate(p_ptr, p_size, p_alignment);
+    }
+
+    size_t blocks;
+};
+
+} // namespace
+
+TEST(sized_memory_pool, ShouldNotCountFailedAllocations)
+{
+    for (size_t thread_cache : {0u, 8u})
+    {
+        sized_memory_pool<alignof(std::max_align_t), limited_allocator> sp(64, limited_allocator{1}, thread_cache, 64);
+        auto block = sp.allocate_raw();
+        EXPECT_THROW(sp.allocate_raw(), std::bad_alloc);
+        EXPECT_THROW(sp.allocate_raw(), std::bad_alloc);
+        auto stats = sp.stats();
+        EXPECT_EQ(1u, stats.allocations);
+        EXPECT_EQ(64u, stats.outstanding_bytes);
+        sp.free(block);
+    }
+}
+
+TEST(sized_memory_pool, ShouldCountUsage)
+{
+    for (size_t thread_cache : {0u, 8u})
+    {
+        sized_memory_pool sp(48, {}, thread_cache);
+        std::vector<std::byte*> blocks;
+        for (size_t i=0; i<10; i++)
+        {
+            blocks.emplace_back(sp.allocate_raw());
+        }
+        for (size_t i=0; i<4; i++)
+        {
+            sp.free(blocks[i]);
+        }
+
+        auto stats = sp.stats();
+        EXPECT_EQ(48u, stats.block_size);
+        EXPECT_EQ(10u, stats.allocations);
+        EXPECT_EQ(4u, stats.frees);
+        EXPECT_EQ(6u*48, stats.outstanding_bytes);
+        EXPECT_EQ(sp.capacity()*48 - 6*48, stats.retained_bytes);
+        EXPECT_LE(10u*48, stats.high_water_bytes);
+        EXPECT_LE(1u, stats.misses);
+
+        for (size_t i=4; i<10; i++)
+        {
+            sp.free(blocks[i]);
+        }
+        EXPECT_EQ(0u, sp.stats().outstanding_bytes);
+    }
+}
+
+TEST(log2_memory_pool, ShouldDumpStatsThroughCommandManager)
+{
+    log2_memory_pool pool;
+    auto block = pool.allocate_raw(100);
+    command_manager man;
+    man.add("pool_stats", [&](args_map&&) -> std::string {
+            return to_string(pool.stats());
+        });
+
+    auto dump = man.execute("pool_stats");
+    EXPECT_NE(std::string::npos, dump.find("block_size: 128 allocations: 1 frees: 0 misses: 1 outstanding_bytes: 128"));
+    EXPECT_EQ(1, std::count(dump.begin(), dump.end(), '\n'));
+    pool.free(block);
+}
+
+TEST(log2_pool_spill, ShouldSpillToPool)
+{
+    std::array<uint64_t, 8> data{};
+    data[7] = 42;
+    spill_light_function<uint64_t()> fn([data]() {return data[7];});
+    auto fn2 = fn;
+    EXPECT_EQ(42u, fn());
+    EXPECT_EQ(42u, fn2());
+}
+
+TEST(sized_pool_spill, ShouldSpillToPool)
+{
+    std::array<uint64_t, 8> data{};
+    data[7] = 42;
+    light_function<uint64_t(), sized_pool_spill<64>> fn([data]() {return data[7];});
+    EXPECT_EQ(42u, fn());
+}
+
+TEST(pooled_buffer, ShouldBeCompact)
+{
+    EXPECT_EQ(16u, sizeof(pooled_buffer));
+}
+
+TEST(pooled_buffer, ShouldReturnBlockToPool)
+{
+    sized_memory_pool sp(64);
+    sized_memory_pool other(64);
+    std::byte* first;
+    {
+        auto buffer = sp.allocate_pooled();
+        first = buffer.data();
+        ASSERT_NE(nullptr, first);
+        EXPECT_EQ(64u, buffer.size());
+        EXPECT_EQ(sp.id(), buffer.pool_id());
+
+        buffer_view view(buffer);
+        EXPECT_EQ(first, view.data());
+        EXPECT_EQ(64u, view.size());
+
+        auto moved = std::move(buffer);
+        EXPECT_EQ(nullptr, buffer.data());
+        EXPECT_EQ(first, moved.data());
+    }
+    EXPECT_EQ(first, sp.allocate_raw());
+    sp.free(first);
+    EXPECT_NE(first, other.allocate_pooled().data());
+}
+
+TEST(pooled_buffer, ShouldAllocateFromLog2Pool)
+{
+    log2_memory_pool pool;
+    std::vector<pooled_buffer> buffers;
+    for (size_t i=9; i<16384; i*=2)
+    {
+        buffers.emplace_back(pool.allocate_pooled(i));
+        EXPECT_LE(i, buffers.back().size());
+    }
+}
+
+TEST(mmap_block_allocator, ShouldCarveBlocksFromRegion)
+{
+    mmap_block_allocator allocator(64*1024, mmap_populate);
+    sized_memory_pool<64, mmap_block_allocator> sp(1024, allocator);
+    auto b1 = sp.allocate();
+    auto b2 = sp.allocate();
+    EXPECT_EQ(0u, uintptr_t(b1.data()) % 64);
+    EXPECT_EQ(b1.data() + 1024, b2.data());
+    EXPECT_EQ(64u*1024, allocator.mapped());
+}
+
+TEST(mmap_block_allocator, ShouldShareRegionsAcrossSizeClasses)
+{
+    mmap_block_allocator allocator(1, mmap_hugepages);
+    log2_memory_pool<alignof(std::max_align_t), mmap_block_allocator> pool(allocator);
+    std::vector<buffer> buffers;
+    for (size_t i=9; i<16384; i*=2)
+    {
+        buffers.emplace_back(pool.allocate(i));
+        std::memset(buffers.back().data(), 0xA5, buffers.back().size());
+    }
+    EXPECT_EQ(mmap_block_allocator::huge_page_size, allocator.mapped());
+}
+
+TEST(mmap_block_allocator, ShouldReserveAhead)
+{
+    mmap_block_allocator allocator(4096, mmap_none);
+    allocator.reserve(3*4096);
+    EXPECT_EQ(3u*4096, allocator.mapped());
+    // One block per slab so every slab fits in a reserved region.
+    sized_memory_pool<alignof(std::max_align_t), mmap_block_allocator> sp(4096, allocator,
+        sized_memory_pool<>::default_thread_cache, 4096);
+    for (int i=0; i<3; i++)
+    {
+        sp.allocate_raw();
+    }
+    EXPECT_EQ(3u*4096, allocator.mapped());
+}
+
+TEST(mmap_block_allocator, ShouldReuseTrimmedSlabs)
+{
+    mmap_block_allocator allocator(64*1024, mmap_none);
+    sized_memory_pool<64, mmap_block_allocator> sp(1024, allocator, 0, 8*1024, 0);
+    size_t mapped = 0;
+    for (int round=0; round<8; round++)
+    {
+        std::vector<std::byte*> blocks;
+        for (size_t i=0; i<128; i++)
+        {
+            blocks.emplace_back(sp.allocate_raw());
+            std::memset(blocks.back(), 0xA5, 1024);
+        }
+        for (auto block : blocks)
+        {
+            sp.free(block);
+        }
+        sp.trim();
+        EXPECT_EQ(0u, sp.capacity());
+        if (!round)
+        {
+            mapped = allocator.mapped();
+        }
+        EXPECT_EQ(mapped, allocator.mapped());
+    }
+}
+
+TEST(mmap_block_allocator, ShouldSplitAndMergeFreeRanges)
+{
+    mmap_block_allocator allocator(64*1024, mmap_none);
+    auto a = allocator.allocate(4096, 4096);
+    auto b = allocator.allocate(4096, 4096);
+    auto c = allocator.allocate(4096, 4096);
+    allocator.deallocate(a, 4096, 4096);
+    allocator.deallocate(c, 4096, 4096);
+    allocator.deallocate(b, 4096, 4096);
+
+    auto big = allocator.allocate(3*4096, 4096);
+    EXPECT_EQ(a, big);
+    allocator.deallocate(big, 3*4096, 4096);
+    EXPECT_EQ(a, allocator.allocate(64, 64));
+    EXPECT_EQ(a + 64, allocator.allocate(64, 64));
+    EXPECT_EQ(64u*1024, allocator.mapped());
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <numeric>
+#include <vector>
+#include <memory_resource>
+
+#include <bfc/memory_resource.hpp>
+#include <bfc/event_queue.hpp>
+#include <bfc/timer.hpp>
+#include <bfc/configuration_parser.hpp>
+#include <bfc/epoll_reactor.hpp>
+
+using namespace bfc;
+
+TEST(log2_pool_resource, ShouldBackPmrContainers)
+{
+    log2_memory_pool pool;
+    log2_pool_resource resource(pool);
+    std::pmr::vector<uint64_t> values(&resource);
+    for (uint64_t i=0; i<1000; i++)
+    {
+        values.push_back(i);
+    }
+    EXPECT_EQ(499500u, std::accumulate(values.begin(), values.end(), uint64_t(0)));
+
+    size_t allocations = 0;
+    for (auto& stats : pool.stats())
+    {
+        allocations += stats.allocations;
+    }
+    EXPECT_LT(0u, allocations);
+}
+
+TEST(log2_pool_resource, ShouldForwardOveralignedToUpstream)
+{
+    log2_memory_pool pool;
+    log2_pool_resource resource(pool);
+    auto ptr = resource.allocate(64, 4096);
+    EXPECT_EQ(0u, uintptr_t(ptr) % 4096);
+    resource.deallocate(ptr, 64, 4096);
+}
+
+TEST(sized_pool_resource, ShouldAllocateNodesFromPool)
+{
+    sized_memory_pool sp(64, {}, 0);
+    sized_pool_resource resource(sp);
+    {
+        std::pmr::map<int, int> map(&resource);
+        for (int i=0; i<100; i++)
+        {
+            map.emplace(i, i);
+        }
+        EXPECT_EQ(100u, sp.stats().allocations);
+    }
+    EXPECT_EQ(0u, sp.stats().outstanding_bytes);
+
+    auto ptr = resource.allocate(1000);
+    EXPECT_EQ(100u, sp.stats().allocations);
+    resource.deallocate(ptr, 1000);
+}
+
+TEST(monotonic_arena, ShouldReuseChunksAfterReset)
+{
+    monotonic_arena arena(1024);
+    auto first = arena.allocate(100);
+    auto second = arena.allocate(8, 64);
+    EXPECT_EQ(0u, uintptr_t(second) % 64);
+    EXPECT_LT(first, second);
+    EXPECT_NE(nullptr, arena.allocate(2000));
+    EXPECT_EQ(2108u, arena.used());
+    auto capacity = arena.capacity();
+
+    arena.reset();
+    EXPECT_EQ(0u, arena.used());
+    EXPECT_EQ(first, arena.allocate(100));
+    EXPECT_NE(nullptr, arena.allocate(2000));
+    EXPECT_EQ(capacity, arena.capacity());
+
+    arena.release();
+    EXPECT_EQ(0u, arena.capacity());
+}
+
+TEST(event_queue, ShouldUseAllocator)
+{
+    monotonic_arena arena;
+    event_queue<int, std::pmr::polymorphic_allocator<int>> queue(false, &arena);
+    queue.push(1);
+    queue.push(2);
+    EXPECT_LT(0u, arena.used());
+
+    int sum = 0;
+    EXPECT_EQ(2u, queue.pop([&](int& p_value){ sum += p_value; }));
+    EXPECT_EQ(3, sum);
+    EXPECT_EQ(&arena, queue.pop().get_allocator().resource());
+}
+
+TEST(timer, ShouldUseAllocator)
+{
+    sized_memory_pool sp(128, {}, 0);
+    sized_pool_resource resource(sp);
+    timer<std::function<void()>, std::pmr::polymorphic_allocator<std::byte>> sut(&resource);
+    int fired = 0;
+    sut.wait_ms(10, [&](){ fired++; }, 0);
+    sut.wait_ms(20, [&](){ fired++; }, 0);
+    EXPECT_EQ(2u, sp.stats().allocations - sp.stats().frees);
+
+    sut.schedule(15);
+    EXPECT_EQ(1, fired);
+    sut.schedule(25);
+    EXPECT_EQ(2, fired);
+}
+
+TEST(args_map, ShouldUseAllocator)
+{
+    monotonic_arena arena;
+    basic_args_map<std::pmr::polymorphic_allocator<char>> args(&arena);
+    args.emplace("fd", "1");
+    args.emplace("trigger", "a value long enough to skip the small string buffer");
+    EXPECT_LT(0u, arena.used());
+    EXPECT_EQ(1, *args.as<int>("fd"));
+    EXPECT_EQ("a value long enough to skip the small string buffer", *args.arg("trigger"));
+    EXPECT_FALSE(args.arg("size"));
+}
+
+TEST(monotonic_arena, ShouldReturnChunksAboveMaxRetained)
+{
+    monotonic_arena arena(1024, std::pmr::new_delete_resource(), 2048);
+    for (int i=0; i<8; i++)
+    {
+        EXPECT_NE(nullptr, arena.allocate(1000));
+    }
+    EXPECT_EQ(8u*1024, arena.capacity());
+    arena.reset();
+    EXPECT_EQ(2048u, arena.capacity());
+}
+
+TEST(epoll_reactor, ShouldResetScratchEachIteration)
+{
+    epoll_reactor<> reactor;
+    EXPECT_EQ(std::pmr::get_default_resource(), scratch_resource());
+
+    bool in_loop = false;
+    reactor.wake_up([&]() {
+            in_loop = (&reactor.scratch() == scratch_resource());
+            std::pmr::string message("a scratch string long enough to skip the small string buffer", scratch_resource());
+        });
+
+    size_t used = 0;
+    reactor.run([&]() {
+            used = reactor.scratch().used();
+            reactor.stop();
+        });
+
+    EXPECT_TRUE(in_loop);
+    EXPECT_LT(0u, used);
+    EXPECT_EQ(0u, reactor.scratch().used());
+    EXPECT_EQ(std::pmr::get_default_resource(), scratch_resource());
+}
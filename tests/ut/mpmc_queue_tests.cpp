@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+
+#include <bfc/mpmc_queue.hpp>
+
+using namespace bfc;
+
+TEST(mpmc_queue, ShouldPopInOrder)
+{
+    mpmc_queue<int> queue(4);
+    EXPECT_EQ(4u, queue.capacity());
+    EXPECT_TRUE(queue.empty());
+
+    for (int i=0; i<4; i++)
+    {
+        EXPECT_TRUE(queue.try_emplace(i));
+    }
+    EXPECT_EQ(4u, queue.size());
+
+    int value;
+    for (int i=0; i<4; i++)
+    {
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(queue.try_pop(value));
+}
+
+TEST(mpmc_queue, ShouldRoundCapacityUp)
+{
+    mpmc_queue<int> queue(5);
+    EXPECT_EQ(8u, queue.capacity());
+}
+
+TEST(mpmc_queue, ShouldFailWhenFullAndKeepArgument)
+{
+    mpmc_queue<std::unique_ptr<int>> queue(2);
+    EXPECT_TRUE(queue.try_emplace(std::make_unique<int>(1)));
+    EXPECT_TRUE(queue.try_emplace(std::make_unique<int>(2)));
+
+    auto value = std::make_unique<int>(3);
+    EXPECT_FALSE(queue.try_emplace(std::move(value)));
+    ASSERT_NE(nullptr, value);
+
+    std::unique_ptr<int> out;
+    ASSERT_TRUE(queue.try_pop(out));
+    EXPECT_EQ(1, *out);
+    EXPECT_TRUE(queue.try_emplace(std::move(value)));
+    EXPECT_EQ(nullptr, value);
+}
+
+TEST(mpmc_queue, ShouldDeliverEveryElementOnceAcrossThreads)
+{
+    constexpr size_t PRODUCERS = 4;
+    constexpr size_t PER_PRODUCER = 10000;
+    mpmc_queue<size_t> queue(64);
+    std::vector<std::atomic<int>> seen(PRODUCERS*PER_PRODUCER);
+    std::atomic<size_t> popped = 0;
+
+    std::vector<std::thread> threads;
+    for (size_t p=0; p<PRODUCERS; p++)
+    {
+        threads.emplace_back([&queue, p]() {
+                for (size_t i=0; i<PER_PRODUCER; i++)
+                {
+                    while (!queue.try_emplace(p*PER_PRODUCER + i))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        threads.emplace_back([&]() {
+                size_t value;
+                while (popped.load() < PRODUCERS*PER_PRODUCER)
+                {
+                    if (queue.try_pop(value))
+                    {
+                        seen[value]++;
+                        popped++;
+                    }
+                    else
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+    }
+
+    for (auto& i : threads)
+    {
+        i.join();
+    }
+
+    for (auto& i : seen)
+    {
+        EXPECT_EQ(1, i.load());
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(mpmc_queue, ShouldPushBulkUpToFreeSpace)
+{
+    mpmc_queue<int> queue(8);
+    EXPECT_TRUE(queue.try_emplace(-1));
+    EXPECT_EQ(7u, queue.try_emplace_bulk(10, [](size_t i){return int(i);}));
+    EXPECT_EQ(0u, queue.try_emplace_bulk(1, [](size_t i){return int(i);}));
+
+    int value;
+    ASSERT_TRUE(queue.try_pop(value));
+    EXPECT_EQ(-1, value);
+    for (int i=0; i<7; i++)
+    {
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(queue.try_pop(value));
+}
+
+TEST(mpmc_queue, ShouldPublishDefaultsWhenBulkFactoryThrows)
+{
+    mpmc_queue<int> queue(8);
+    EXPECT_THROW(queue.try_emplace_bulk(4, [](size_t i) {
+            if (2 == i)
+            {
+                throw std::runtime_error("make");
+            }
+            return int(i) + 1;
+        }), std::runtime_error);
+    EXPECT_EQ(4u, queue.size());
+
+    int value;
+    std::vector<int> popped;
+    while (queue.try_pop(value))
+    {
+        popped.push_back(value);
+    }
+    EXPECT_EQ((std::vector<int>{1, 2, 0, 0}), popped);
+
+    EXPECT_TRUE(queue.try_emplace(5));
+    ASSERT_TRUE(queue.try_pop(value));
+    EXPECT_EQ(5, value);
+}
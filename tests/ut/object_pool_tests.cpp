@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <bfc/object_pool.hpp>
+
+using namespace bfc;
+
+struct connection
+{
+    connection(int p_fd, std::string p_name)
+        : fd(p_fd)
+        , name(std::move(p_name))
+    {
+        alive++;
+    }
+
+    ~connection()
+    {
+        alive--;
+    }
+
+    int fd;
+    std::string name;
+    static inline int alive = 0;
+};
+
+TEST(object_pool, ShouldConstructAndDestroyInPlace)
+{
+    object_pool<connection> pool;
+    {
+        auto conn = pool.make_unique(3, "peer");
+        EXPECT_EQ(3, conn->fd);
+        EXPECT_EQ("peer", conn->name);
+        EXPECT_EQ(1, connection::alive);
+        EXPECT_EQ(sizeof(void*)*2, sizeof(conn));
+    }
+    EXPECT_EQ(0, connection::alive);
+
+    auto stats = pool.stats();
+    EXPECT_EQ(1u, stats.allocations);
+    EXPECT_EQ(1u, stats.frees);
+}
+
+TEST(object_pool, ShouldReuseSlots)
+{
+    object_pool<connection> pool({}, 0);
+    auto first = pool.construct(1, "a");
+    pool.destroy(first);
+    auto second = pool.construct(2, "b");
+    EXPECT_EQ(first, second);
+    pool.destroy(second);
+}
+
+TEST(object_pool, ShouldInvalidateStaleHandles)
+{
+    object_pool<connection> pool({}, 0);
+    auto conn = pool.construct(1, "a");
+    auto handle = pool.get_handle(conn);
+    EXPECT_EQ(conn, pool.get(handle));
+
+    pool.destroy(conn);
+    EXPECT_EQ(nullptr, pool.get(handle));
+
+    auto reused = pool.construct(2, "b");
+    auto new_handle = pool.get_handle(reused);
+    EXPECT_EQ(handle.index, new_handle.index);
+    EXPECT_NE(handle, new_handle);
+    EXPECT_EQ(nullptr, pool.get(handle));
+    EXPECT_EQ(reused, pool.get(new_handle));
+    EXPECT_EQ(nullptr, pool.get(object_pool<connection>::handle{}));
+    pool.destroy(reused);
+}
+
+TEST(object_pool, ShouldLookUpFromOtherThreads)
+{
+    object_pool<connection> pool;
+    pool.reserve(1000);
+    std::vector<object_pool<connection>::unique_ptr> conns;
+    std::vector<object_pool<connection>::handle> handles;
+    for (int i=0; i<1000; i++)
+    {
+        conns.emplace_back(pool.make_unique(i, "conn"));
+        handles.emplace_back(pool.get_handle(conns.back().get()));
+    }
+
+    std::thread([&]() {
+            for (int i=0; i<1000; i++)
+            {
+                auto conn = pool.get(handles[i]);
+                ASSERT_NE(nullptr, conn);
+                EXPECT_EQ(i, conn->fd);
+            }
+        }).join();
+}
+
+TEST(object_pool, ShouldReturnSlotWhenConstructorThrows)
+{
+    struct throwing
+    {
+        throwing()
+        {
+            throw std::runtime_error("fail");
+        }
+    };
+
+    object_pool<throwing> pool({}, 0);
+    EXPECT_THROW(pool.construct(), std::runtime_error);
+    auto stats = pool.stats();
+    EXPECT_EQ(0u, stats.outstanding_bytes);
+}
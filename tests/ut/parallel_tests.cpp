@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <future>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <bfc/parallel.hpp>
+#include <bfc/thread_pool.hpp>
+#include <bfc/work_stealing_pool.hpp>
+
+using namespace bfc;
+
+TEST(parallel, ShouldVisitEveryIndexOnce)
+{
+    thead_pool<> pool(3);
+    std::vector<std::atomic<int>> seen(10000);
+    parallel_for(pool, 0, seen.size(), [&seen](size_t i){seen[i]++;});
+    for (auto& i : seen)
+    {
+        EXPECT_EQ(1, i.load());
+    }
+
+    parallel_for(pool, 5, 5, [](size_t){FAIL();});
+}
+
+TEST(parallel, ShouldReduce)
+{
+    work_stealing_pool<> pool(3);
+    auto sum = parallel_reduce(pool, 0, 100000, uint64_t(0),
+        [](size_t i){return uint64_t(i);},
+        [](uint64_t a, uint64_t b){return a + b;});
+    EXPECT_EQ(uint64_t(100000)*99999/2, sum);
+}
+
+TEST(parallel, ShouldTransform)
+{
+    thead_pool<> pool(2);
+    std::vector<int> in(5000);
+    std::iota(in.begin(), in.end(), 0);
+    std::vector<int> out(in.size());
+    auto end = parallel_transform(pool, in.begin(), in.end(), out.begin(), [](int v){return v*2;}, 100);
+    EXPECT_EQ(out.end(), end);
+    for (size_t i=0; i<in.size(); i++)
+    {
+        EXPECT_EQ(int(i*2), out[i]);
+    }
+}
+
+TEST(parallel, ShouldSort)
+{
+    thead_pool<> pool(3);
+    std::vector<uint32_t> values(100000);
+    std::mt19937 rng(42);
+    for (auto& i : values)
+    {
+        i = rng();
+    }
+    auto expected = values;
+    std::sort(expected.begin(), expected.end());
+
+    parallel_sort(pool, values.begin(), values.end(), std::less<>(), 1024);
+    EXPECT_EQ(expected, values);
+
+    parallel_sort(pool, values.begin(), values.end(), std::greater<>(), 1024);
+    EXPECT_TRUE(std::is_sorted(values.begin(), values.end(), std::greater<>()));
+}
+
+TEST(parallel, ShouldRethrowFirstException)
+{
+    thead_pool<> pool(2);
+    std::atomic<size_t> visited = 0;
+    EXPECT_THROW(parallel_for(pool, 0, 1000, [&visited](size_t i) {
+            visited++;
+            if (i == 10)
+            {
+                throw std::runtime_error("chunk failed");
+            }
+        }, 1), std::runtime_error);
+    EXPECT_LT(visited.load(), 1000u);
+}
+
+TEST(parallel, ShouldNestInWorkStealingPool)
+{
+    work_stealing_pool<> pool(2);
+    std::vector<std::atomic<int>> seen(64*64);
+    parallel_for(pool, 0, 64, [&](size_t i) {
+            parallel_for(pool, 0, 64, [&](size_t j){seen[i*64 + j]++;});
+        }, 1);
+    for (auto& i : seen)
+    {
+        EXPECT_EQ(1, i.load());
+    }
+}
+
+TEST(parallel, ShouldWorkWhenQueueRejects)
+{
+    thead_pool<> pool(1, 2, overflow_policy::reject);
+    std::atomic<size_t> count = 0;
+    parallel_for(pool, 0, 1000, [&count](size_t){count++;}, 1);
+    EXPECT_EQ(1000u, count.load());
+}
+
+TEST(parallel, ShouldNotWaitForHelpersThatNeverStarted)
+{
+    // Every worker is busy until the loop returned, the caller runs all
+    // chunks and the helpers find nothing left once they start.
+    thead_pool<> pool(2, 16);
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::atomic<size_t> started = 0;
+    for (int i=0; i<2; i++)
+    {
+        pool.execute([opened, &started](){started++; opened.wait();});
+    }
+    while (started.load() < 2)
+    {
+        std::this_thread::yield();
+    }
+
+    std::vector<int> seen(1000);
+    parallel_for(pool, 0, seen.size(), [&seen](size_t i){seen[i]++;}, 1);
+    gate.set_value();
+    EXPECT_EQ(seen.size(), size_t(std::count(seen.begin(), seen.end(), 1)));
+}
+
+TEST(parallel, ShouldRunFromThreadPoolWorker)
+{
+    thead_pool<> pool(1);
+    std::promise<size_t> res;
+    pool.execute([&pool, &res]() {
+            std::atomic<size_t> count = 0;
+            parallel_for(pool, 0, 100, [&count](size_t){count++;}, 1);
+            res.set_value(count.load());
+        });
+    EXPECT_EQ(100u, res.get_future().get());
+}
+
+TEST(parallel, ShouldNotBlockOnFullQueueFromWorker)
+{
+    // A single worker with a full blocking queue, queuing helpers with
+    // execute() would wait for space only this worker can make.
+    thead_pool<> pool(1, 2, overflow_policy::block);
+    std::promise<size_t> res;
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    pool.execute([&pool, &res, &opened]() {
+            opened.wait();
+            std::atomic<size_t> count = 0;
+            parallel_for(pool, 0, 100, [&count](size_t){count++;}, 1);
+            res.set_value(count.load());
+        });
+    while (pool.count_active() < 1)
+    {
+        std::this_thread::yield();
+    }
+    pool.execute([](){});
+    pool.execute([](){});
+    gate.set_value();
+    EXPECT_EQ(100u, res.get_future().get());
+}
+
+TEST(parallel, ShouldSleepOutsideWorkStealingPool)
+{
+    // The chunk the pool's worker claims takes a while, the caller sleeps
+    // on the latch meanwhile instead of yielding in a loop.
+    work_stealing_pool<> pool(1);
+    std::atomic<size_t> count = 0;
+    auto cpu_before = std::clock();
+    parallel_for(pool, 0, 2, [&count](size_t) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            count++;
+        }, 1);
+    auto cpu_used = double(std::clock() - cpu_before) / CLOCKS_PER_SEC;
+    EXPECT_EQ(2u, count.load());
+    EXPECT_GT(0.05, cpu_used);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sys/socket.h>
+
+#include <bfc/ring_buffer.hpp>
+#include <bfc/socket.hpp>
+
+using namespace bfc;
+
+TEST(mirrored_ring_buffer, ShouldRoundToPageSize)
+{
+    mirrored_ring_buffer ring(100);
+    EXPECT_EQ(size_t(sysconf(_SC_PAGESIZE)), ring.capacity());
+    EXPECT_EQ(ring.capacity(), ring.writable().size());
+    EXPECT_EQ(0u, ring.readable().size());
+}
+
+TEST(mirrored_ring_buffer, ShouldExposeContiguousWrappedFrame)
+{
+    mirrored_ring_buffer ring(1);
+    auto capacity = ring.capacity();
+
+    ring.commit(capacity - 4);
+    ring.consume(capacity - 4);
+
+    auto w = ring.writable();
+    ASSERT_EQ(capacity, w.size());
+    std::memcpy(w.data(), "0123456789", 10);
+    ring.commit(10);
+
+    auto r = ring.readable();
+    ASSERT_EQ(10u, r.size());
+    EXPECT_EQ(0, std::memcmp(r.data(), "0123456789", 10));
+
+    ring.consume(4);
+    EXPECT_EQ(0, std::memcmp(ring.readable().data(), "456789", 6));
+    EXPECT_EQ(capacity - 6, ring.writable().size());
+}
+
+TEST(mirrored_ring_buffer, ShouldRejectOverflow)
+{
+    mirrored_ring_buffer ring(1);
+    EXPECT_THROW(ring.commit(ring.capacity() + 1), std::out_of_range);
+    EXPECT_THROW(ring.consume(1), std::out_of_range);
+}
+
+TEST(mirrored_ring_buffer, ShouldReassembleStream)
+{
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    bfc::socket tx(fds[0]);
+    bfc::socket rx(fds[1]);
+
+    mirrored_ring_buffer ring(1);
+    const uint32_t frame_size = 100;
+    const uint32_t frames = 3 * ring.capacity() / frame_size;
+    uint32_t sent = 0;
+    uint32_t parsed = 0;
+
+    while (parsed < frames)
+    {
+        if (sent < frames)
+        {
+            uint32_t frame[frame_size/sizeof(uint32_t)];
+            std::fill(std::begin(frame), std::end(frame), sent++);
+            // Split the frame to force partial reads.
+            ASSERT_EQ(30, tx.send(buffer_view((std::byte*) frame, 30)));
+            ASSERT_EQ(70, tx.send(buffer_view((std::byte*) frame + 30, 70)));
+        }
+
+        auto rc = rx.recv(ring.writable(), MSG_DONTWAIT);
+        ASSERT_LT(0, rc);
+        ring.commit(rc);
+
+        while (ring.size() >= frame_size)
+        {
+            auto frame = (uint32_t*) ring.readable().data();
+            ASSERT_EQ(parsed, frame[0]);
+            ASSERT_EQ(parsed, frame[frame_size/sizeof(uint32_t) - 1]);
+            ring.consume(frame_size);
+            parsed++;
+        }
+    }
+}
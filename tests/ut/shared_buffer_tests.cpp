@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <bfc/shared_buffer.hpp>
+
+using namespace bfc;
+
+TEST(shared_buffer, ShouldAllocateFromPool)
+{
+    shared_buffer_pool pool(1500);
+    auto buffer = pool.allocate();
+    ASSERT_NE(nullptr, buffer.data());
+    EXPECT_EQ(1500u, buffer.size());
+    EXPECT_EQ(1u, buffer.use_count());
+    EXPECT_EQ(0u, uintptr_t(buffer.data()) % alignof(std::max_align_t));
+}
+
+TEST(shared_buffer, ShouldSliceWithoutCopy)
+{
+    shared_buffer_pool pool(64);
+    auto buffer = pool.allocate();
+    std::memcpy(buffer.data(), "headerpayload", 13);
+
+    auto header = buffer.slice(0, 6);
+    auto payload = buffer.slice(6, 7);
+    EXPECT_EQ(3u, buffer.use_count());
+    EXPECT_EQ(buffer.data(), header.data());
+    EXPECT_EQ(buffer.data() + 6, payload.data());
+    EXPECT_EQ(0, std::memcmp(payload.data(), "payload", 7));
+
+    auto tail = payload.slice(4);
+    EXPECT_EQ(3u, tail.size());
+    EXPECT_THROW(payload.slice(4, 4), std::out_of_range);
+
+    const_buffer_view view(tail);
+    EXPECT_EQ(tail.data(), view.data());
+    EXPECT_EQ(3u, view.size());
+}
+
+TEST(shared_buffer, ShouldReturnBlockOnLastRelease)
+{
+    shared_buffer_pool pool(64);
+    std::byte* first;
+    {
+        auto buffer = pool.allocate();
+        first = buffer.data();
+        auto slice = buffer.slice(8, 8);
+        buffer.reset();
+        EXPECT_EQ(1u, slice.use_count());
+        auto other = pool.allocate();
+        EXPECT_NE(first, other.data());
+    }
+    auto buffer = pool.allocate();
+    EXPECT_EQ(first, buffer.data());
+}
+
+TEST(shared_buffer, ShouldShareAcrossThreads)
+{
+    shared_buffer_pool pool(64);
+    auto buffer = pool.allocate();
+    std::vector<std::thread> consumers;
+    for (int i=0; i<4; i++)
+    {
+        consumers.emplace_back([slice = buffer.slice(i*8, 8)]() mutable {
+                for (int j=0; j<1000; j++)
+                {
+                    auto copy = slice;
+                }
+            });
+    }
+    for (auto& i : consumers)
+    {
+        i.join();
+    }
+    EXPECT_EQ(1u, buffer.use_count());
+}
+
+TEST(shared_buffer, ShouldAllocateFromHeap)
+{
+    auto buffer = make_shared_buffer(100);
+    auto copy = buffer;
+    EXPECT_EQ(100u, copy.size());
+    EXPECT_EQ(2u, buffer.use_count());
+}
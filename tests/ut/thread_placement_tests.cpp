@@ -0,0 +1,256 @@
+#include <gtest/gtest.h>
+
+#include <sched.h>
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <set>
+
+#include <bfc/epoll_reactor.hpp>
+#include <bfc/thread_placement.hpp>
+#include <bfc/thread_pool.hpp>
+#include <bfc/work_stealing_pool.hpp>
+
+using namespace bfc;
+
+// Two packages of two cores with two SMT threads each, cpuN and cpuN+4 are
+// siblings.
+static std::string make_sysfs()
+{
+    auto root = std::filesystem::temp_directory_path() / ("bfc_sysfs_" + std::to_string(getpid()));
+    std::filesystem::create_directories(root);
+    std::ofstream(root / "online") << "0-7\n";
+    for (int cpu=0; cpu<8; cpu++)
+    {
+        auto topology = root / ("cpu" + std::to_string(cpu)) / "topology";
+        std::filesystem::create_directories(topology);
+        std::ofstream(topology / "core_id") << (cpu % 2) << "\n";
+        std::ofstream(topology / "physical_package_id") << (cpu % 4) / 2 << "\n";
+    }
+    return root;
+}
+
+static int first_allowed_cpu()
+{
+    cpu_set_t set;
+    sched_getaffinity(0, sizeof(set), &set);
+    for (int i=0; i<CPU_SETSIZE; i++)
+    {
+        if (CPU_ISSET(i, &set))
+        {
+            return i;
+        }
+    }
+    return 0;
+}
+
+TEST(thread_placement, ShouldParseCpuList)
+{
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 8, 10, 11}), parse_cpu_list("0-3,8, 10-11\n"));
+    EXPECT_TRUE(parse_cpu_list("").empty());
+    EXPECT_THROW(parse_cpu_list("3-1"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("a"), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list(std::to_string(CPU_SETSIZE)), std::invalid_argument);
+    EXPECT_THROW(parse_cpu_list("0-" + std::to_string(CPU_SETSIZE)), std::invalid_argument);
+}
+
+TEST(thread_placement, ShouldRejectCpusOutsideCpuSet)
+{
+    EXPECT_THROW(thread_placement("w", {0, CPU_SETSIZE}), std::invalid_argument);
+    EXPECT_THROW(thread_placement("w", {-1}), std::invalid_argument);
+
+    args_map config;
+    config.emplace("w.smt", "1");
+    EXPECT_THROW(thread_placement::from_config(config, "w", cpu_topology({{CPU_SETSIZE, 0, 0}})), std::invalid_argument);
+}
+
+TEST(thread_placement, ShouldLoadTopology)
+{
+    auto root = make_sysfs();
+    auto topology = cpu_topology::load(root);
+    std::filesystem::remove_all(root);
+
+    ASSERT_EQ(8u, topology.cpus().size());
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3}), topology.primary());
+    EXPECT_EQ((std::vector<int>{1, 2, 3, 5, 6, 7}), topology.exclude_cores(topology.all(), {4}));
+}
+
+TEST(thread_placement, ShouldReadConfiguration)
+{
+    auto root = make_sysfs();
+    auto topology = cpu_topology::load(root);
+    std::filesystem::remove_all(root);
+
+    configuration_parser config;
+    config.load_line("io.name = io");
+    config.load_line("io.cpus = 0");
+    config.load_line("workers.name = worker");
+    config.load_line("workers.smt = 0");
+    config.load_line("workers.exclude_cores = 0");
+    config.load_line("workers.pin = 0");
+
+    auto io = thread_placement::from_config(config, "io", topology);
+    EXPECT_EQ("io", io.name());
+    EXPECT_EQ((std::vector<int>{0}), io.cpus());
+    EXPECT_TRUE(io.pinned());
+
+    auto workers = thread_placement::from_config(config, "workers", topology);
+    EXPECT_EQ((std::vector<int>{1, 2, 3}), workers.cpus());
+    EXPECT_FALSE(workers.pinned());
+
+    auto none = thread_placement::from_config(config, "other", topology);
+    EXPECT_TRUE(none.name().empty());
+    EXPECT_TRUE(none.cpus().empty());
+
+    config.load_line("bad.cpus = 0");
+    config.load_line("bad.exclude_cores = 4");
+    EXPECT_THROW(thread_placement::from_config(config, "bad", topology), std::invalid_argument);
+}
+
+TEST(thread_placement, ShouldPlacePoolWorkers)
+{
+    auto cpu = first_allowed_cpu();
+    thead_pool<> pool(2, 16, overflow_policy::block, thread_placement("a_long_pool_name", {cpu}));
+
+    for (int i=0; i<2; i++)
+    {
+        std::promise<std::pair<std::string, int>> placed;
+        pool.execute([&placed]() {
+                char name[16];
+                pthread_getname_np(pthread_self(), name, sizeof(name));
+                placed.set_value({name, sched_getcpu()});
+            });
+        auto res = placed.get_future().get();
+        EXPECT_EQ(15u, res.first.size());
+        EXPECT_EQ("a_long_pool_na", res.first.substr(0, 14));
+        EXPECT_EQ(cpu, res.second);
+    }
+}
+
+TEST(thread_placement, ShouldRunReactorOnPlacedThread)
+{
+    auto cpu = first_allowed_cpu();
+    epoll_reactor<> reactor;
+    std::promise<std::string> name;
+    {
+        reactor_runner<epoll_reactor<>> runner(reactor, thread_placement("loop", {cpu}));
+        reactor.wake_up([&name]() {
+                char buffer[16];
+                pthread_getname_np(pthread_self(), buffer, sizeof(buffer));
+                name.set_value(buffer);
+            });
+        EXPECT_EQ("loop0", name.get_future().get());
+    }
+}
+
+TEST(thread_placement, ShouldFailPoolWhenPlacementFails)
+{
+    // Below CPU_SETSIZE but not a CPU of this machine.
+    EXPECT_THROW(thead_pool<>(2, 16, overflow_policy::block, thread_placement("", {CPU_SETSIZE - 1})), std::runtime_error);
+}
+
+TEST(thread_placement, ShouldReuseIndexOfRetiredWorker)
+{
+    elastic_policy policy;
+    policy.min_size = 1;
+    policy.max_size = 2;
+    policy.grow_after = std::chrono::microseconds(100);
+    policy.idle_timeout = std::chrono::milliseconds(20);
+    thead_pool<> pool(policy, 16, overflow_policy::block, thread_placement("w"));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    // Occupies both workers and returns their names.
+    auto grow_to_two = [&]() {
+            struct
+            {
+                std::promise<void> gate;
+                std::shared_future<void> opened = gate.get_future().share();
+                std::mutex names_mtx;
+                std::set<std::string> names;
+            } state;
+            auto& gate = state.gate;
+            auto task = [&state]() {
+                    char name[16];
+                    pthread_getname_np(pthread_self(), name, sizeof(name));
+                    {
+                        std::unique_lock<std::mutex> lg(state.names_mtx);
+                        state.names.insert(name);
+                    }
+                    state.opened.wait();
+                };
+            pool.execute(task);
+            while (pool.count_active() < 2 && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                pool.execute(task);
+            }
+            gate.set_value();
+            while ((pool.count_queued() || pool.count_active()) && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            std::unique_lock<std::mutex> lg(state.names_mtx);
+            return state.names;
+        };
+
+    EXPECT_EQ((std::set<std::string>{"w0", "w1"}), grow_to_two());
+    while (pool.count_retired() < 1 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_EQ(1u, pool.count_retired());
+    EXPECT_EQ((std::set<std::string>{"w0", "w1"}), grow_to_two());
+}
+
+namespace
+{
+
+// Records the thread name run() starts with.
+struct recording_reactor
+{
+    void run()
+    {
+        char name[16];
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        started.set_value(name);
+    }
+
+    template <typename callable_t>
+    void wake_up(callable_t&& p_cb)
+    {
+        p_cb();
+    }
+
+    void stop()
+    {}
+
+    std::promise<std::string> started;
+};
+
+} // namespace
+
+TEST(thread_placement, ShouldPlaceReactorThreadBeforeRunning)
+{
+    recording_reactor reactor;
+    auto started = reactor.started.get_future();
+    reactor_runner<recording_reactor> runner(reactor, thread_placement("loop"));
+    EXPECT_EQ("loop0", started.get());
+}
+
+TEST(thread_placement, ShouldNotRunReactorWhenPlacementFails)
+{
+    recording_reactor reactor;
+    auto started = reactor.started.get_future();
+    EXPECT_THROW(reactor_runner<recording_reactor>(reactor, thread_placement("", {CPU_SETSIZE - 1})), std::runtime_error);
+    EXPECT_EQ(std::future_status::timeout, started.wait_for(std::chrono::seconds(0)));
+}
+
+TEST(thread_placement, ShouldNotRunStealingWorkersWhenPlacementFails)
+{
+    using pool_t = work_stealing_pool<>;
+    EXPECT_THROW(pool_t(2, 16, thread_placement("", {first_allowed_cpu(), CPU_SETSIZE - 1})), std::runtime_error);
+}
@@ -32,3 +32,285 @@ TEST(thead_pool, ShouldExecute)
     std::printf("Pool size %lu\n", pool.size());
 
 }
+
+TEST(thead_pool, ShouldExecuteMoveOnly)
+{
+    thead_pool<unique_light_function<void()>> pool;
+
+    std::promise<int> res;
+    auto value = std::make_unique<int>(42);
+    pool.execute([&res, value = std::move(value)](){res.set_value(*value);});
+    EXPECT_EQ(42, res.get_future().get());
+}
+
+// Occupies every worker of p_pool until the returned promise is set.
+template <typename pool_t>
+static std::shared_future<void> block_workers(pool_t& p_pool, std::promise<void>& p_gate)
+{
+    std::shared_future<void> gate = p_gate.get_future().share();
+    std::atomic<size_t> started = 0;
+    for (size_t i=0; i<p_pool.size(); i++)
+    {
+        p_pool.execute([gate, &started](){started++; gate.wait();});
+    }
+    while (started.load() < p_pool.size())
+    {
+        std::this_thread::yield();
+    }
+    return gate;
+}
+
+TEST(thead_pool, ShouldFailTryExecuteWhenFull)
+{
+    thead_pool<> pool(2, 2, overflow_policy::reject);
+    std::promise<void> gate;
+    block_workers(pool, gate);
+
+    std::atomic<int> ran = 0;
+    EXPECT_TRUE(pool.try_execute([&ran](){ran++;}));
+    EXPECT_TRUE(pool.try_execute([&ran](){ran++;}));
+    EXPECT_FALSE(pool.try_execute([&ran](){ran++;}));
+    EXPECT_FALSE(pool.execute([&ran](){ran++;}));
+    EXPECT_EQ(2u, pool.count_queued());
+    EXPECT_EQ(2u, pool.count_active());
+
+    gate.set_value();
+    while (ran.load() < 2)
+    {
+        std::this_thread::yield();
+    }
+}
+
+TEST(thead_pool, ShouldRunInlineWhenFull)
+{
+    thead_pool<> pool(1, 2, overflow_policy::run_inline);
+    std::promise<void> gate;
+    block_workers(pool, gate);
+
+    pool.execute([](){});
+    pool.execute([](){});
+
+    std::thread::id ran_on;
+    EXPECT_TRUE(pool.execute([&ran_on](){ran_on = std::this_thread::get_id();}));
+    EXPECT_EQ(std::this_thread::get_id(), ran_on);
+    gate.set_value();
+}
+
+TEST(thead_pool, ShouldBlockUntilSpaceWhenFull)
+{
+    thead_pool<> pool(1, 2, overflow_policy::block);
+    std::promise<void> gate;
+    block_workers(pool, gate);
+
+    pool.execute([](){});
+    pool.execute([](){});
+
+    std::promise<void> done;
+    std::atomic<bool> submitted = false;
+    std::thread producer([&]() {
+            pool.execute([&done](){done.set_value();});
+            submitted = true;
+        });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(submitted.load());
+    gate.set_value();
+    done.get_future().wait();
+    producer.join();
+    EXPECT_TRUE(submitted.load());
+}
+
+TEST(thead_pool, ShouldDrainQueueOnDestruction)
+{
+    std::atomic<int> ran = 0;
+    {
+        thead_pool<> pool(2, 64);
+        for (int i=0; i<50; i++)
+        {
+            pool.execute([&ran](){ran++;});
+        }
+    }
+    EXPECT_EQ(50, ran.load());
+}
+
+TEST(thead_pool, ShouldGrowUnderLoadAndRetireWhenIdle)
+{
+    // Outlive the pool, tasks may still be queued on an early return.
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::atomic<int> ran = 0;
+
+    elastic_policy policy;
+    policy.min_size = 1;
+    policy.max_size = 3;
+    policy.grow_after = std::chrono::microseconds(100);
+    policy.idle_timeout = std::chrono::milliseconds(20);
+    thead_pool<> pool(policy);
+    EXPECT_EQ(1u, pool.size());
+    EXPECT_EQ(1u, pool.min_size());
+    EXPECT_EQ(3u, pool.max_size());
+
+    // Generous, only reached when growing or retiring is broken.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    pool.execute([opened, &ran](){opened.wait(); ran++;});
+    while (pool.count_active() < 3 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        pool.execute([opened, &ran](){opened.wait(); ran++;});
+    }
+    auto active = pool.count_active();
+    auto grown = pool.count_grown();
+    gate.set_value();
+    ASSERT_EQ(3u, active);
+    EXPECT_EQ(2u, grown);
+
+    while (pool.size() > 1 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_EQ(1u, pool.size());
+    EXPECT_EQ(2u, pool.count_retired());
+
+    // The remaining worker still runs tasks.
+    std::promise<int> res;
+    pool.execute([&res](){res.set_value(1);});
+    EXPECT_EQ(1, res.get_future().get());
+}
+
+TEST(thead_pool, ShouldRejectZeroMinSize)
+{
+    EXPECT_THROW(thead_pool<>(elastic_policy{0, 4}), std::invalid_argument);
+    EXPECT_THROW(thead_pool<>(0), std::invalid_argument);
+}
+
+TEST(thead_pool, ShouldExecuteBulk)
+{
+    thead_pool<> pool(2, 16);
+    std::atomic<int> ran = 0;
+    std::vector<thead_pool<>::fn_t> tasks(100, [&ran](){ran++;});
+    EXPECT_EQ(100u, pool.execute_bulk(tasks.begin(), tasks.end()));
+    while (ran.load() < 100)
+    {
+        std::this_thread::yield();
+    }
+}
+
+TEST(thead_pool, ShouldRejectBulkTail)
+{
+    thead_pool<unique_light_function<void()>> pool(1, 4, overflow_policy::reject);
+    std::promise<void> gate;
+    block_workers(pool, gate);
+
+    std::atomic<int> ran = 0;
+    std::vector<unique_light_function<void()>> tasks;
+    for (int i=0; i<6; i++)
+    {
+        tasks.emplace_back([&ran](){ran++;});
+    }
+    EXPECT_EQ(4u, pool.execute_bulk(std::make_move_iterator(tasks.begin()), std::make_move_iterator(tasks.end())));
+    EXPECT_FALSE(tasks[3]);
+    EXPECT_TRUE(tasks[4]);
+    EXPECT_TRUE(tasks[5]);
+
+    gate.set_value();
+    while (ran.load() < 4)
+    {
+        std::this_thread::yield();
+    }
+}
+
+namespace
+{
+
+// Copyable task whose copy throws once armed.
+struct throwing_copy_t
+{
+    throwing_copy_t(std::atomic<int>& p_ran, bool p_armed)
+        : ran(&p_ran)
+        , armed(p_armed)
+    {}
+
+    throwing_copy_t(const throwing_copy_t& p_other)
+        : ran(p_other.ran)
+        , armed(p_other.armed)
+    {
+        if (armed)
+        {
+            throw std::runtime_error("copy");
+        }
+    }
+
+    void operator()() const
+    {
+        (*ran)++;
+    }
+
+    std::atomic<int>* ran;
+    bool armed;
+};
+
+} // namespace
+
+TEST(thead_pool, ShouldKeepRunningWhenBulkCopyThrows)
+{
+    thead_pool<big_function<void()>> pool(2, 16);
+    std::atomic<int> ran = 0;
+    std::vector<throwing_copy_t> tasks;
+    tasks.reserve(6);
+    for (int i=0; i<6; i++)
+    {
+        tasks.emplace_back(ran, 3 == i);
+    }
+    EXPECT_THROW(pool.execute_bulk(tasks.begin(), tasks.end()), std::runtime_error);
+
+    std::promise<void> res;
+    pool.execute([&res](){res.set_value();});
+    res.get_future().get();
+    while (ran.load() < 3)
+    {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(3, ran.load());
+}
+
+TEST(thead_pool, ShouldKeepRunningWhenSubmitCopyThrows)
+{
+    thead_pool<big_function<void()>> pool(1, 16);
+    std::atomic<int> ran = 0;
+    throwing_copy_t armed(ran, true);
+    for (int i=0; i<1000; i++)
+    {
+        EXPECT_THROW(pool.submit(armed), std::runtime_error);
+    }
+
+    throwing_copy_t disarmed(ran, false);
+    pool.submit(disarmed).get();
+    EXPECT_EQ(1, ran.load());
+}
+
+TEST(thead_pool, ShouldFailBlockedExecuteWhenStopping)
+{
+    std::atomic<int> ran = 0;
+    std::promise<void> gate;
+    auto pool = std::make_unique<thead_pool<>>(1, 2, overflow_policy::block);
+    auto raw = pool.get();
+    block_workers(*raw, gate);
+    EXPECT_TRUE(raw->execute([&ran](){ran++;}));
+    EXPECT_TRUE(raw->execute([&ran](){ran++;}));
+
+    // The worker is held by the gate, so the destructor cannot finish
+    // before the producer returned.
+    std::promise<bool> queued;
+    std::thread producer([raw, &ran, &queued]() {
+            queued.set_value(raw->execute([&ran](){ran++;}));
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::thread destroyer([&pool](){pool.reset();});
+
+    EXPECT_FALSE(queued.get_future().get());
+    gate.set_value();
+    destroyer.join();
+    producer.join();
+    EXPECT_EQ(2, ran.load());
+}
@@ -1,3 +1,36 @@
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <bfc/timer.hpp>
+
+using namespace bfc;
+
+TEST(timer, ShouldScheduleMoveOnly)
+{
+    timer<unique_light_function<void()>> sut;
+    int fired = 0;
+    auto value = std::make_unique<int>(42);
+    sut.wait_ms(10, [&fired, value = std::move(value)](){fired = *value;}, 0);
+    sut.schedule(9);
+    EXPECT_EQ(0, fired);
+    sut.schedule(10);
+    EXPECT_EQ(42, fired);
+}
+
+TEST(timer, ShouldVisitPending)
+{
+    timer<unique_light_function<void()>> sut;
+    auto id1 = sut.wait_ms(20, [](){}, 0);
+    auto id2 = sut.wait_ms(10, [](){}, 0);
+    std::vector<timer<>::timer_id_t> visited;
+    sut.visit([&visited](const auto& id){visited.emplace_back(id);});
+    ASSERT_EQ(2u, visited.size());
+    EXPECT_EQ(id2, visited[0]);
+    EXPECT_EQ(id1, visited[1]);
+}
+
 // #include <thread>
 
 // #include <gtest/gtest.h>
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <bfc/work_stealing_pool.hpp>
+
+using namespace bfc;
+
+TEST(work_stealing_deque, ShouldPopLifoAndStealFifo)
+{
+    work_stealing_deque<int*> deque(2);
+    int values[8];
+    for (auto& i : values)
+    {
+        deque.push(&i);
+    }
+    EXPECT_EQ(8u, deque.size());
+
+    int* out;
+    ASSERT_TRUE(deque.pop(out));
+    EXPECT_EQ(&values[7], out);
+    ASSERT_TRUE(deque.steal(out));
+    EXPECT_EQ(&values[0], out);
+    EXPECT_EQ(6u, deque.size());
+}
+
+TEST(work_stealing_deque, ShouldHandEveryElementOutOnce)
+{
+    constexpr size_t COUNT = 100000;
+    constexpr size_t THIEVES = 3;
+    std::vector<size_t> values(COUNT);
+    std::vector<std::atomic<int>> seen(COUNT);
+    work_stealing_deque<size_t*> deque(16);
+    std::atomic<size_t> taken = 0;
+
+    std::vector<std::thread> thieves;
+    for (size_t i=0; i<THIEVES; i++)
+    {
+        thieves.emplace_back([&]() {
+                size_t* out;
+                while (taken.load() < COUNT)
+                {
+                    if (deque.steal(out))
+                    {
+                        seen[out - values.data()]++;
+                        taken++;
+                    }
+                }
+            });
+    }
+
+    size_t* out;
+    for (size_t i=0; i<COUNT; i++)
+    {
+        deque.push(&values[i]);
+        if (i % 3 == 0 && deque.pop(out))
+        {
+            seen[out - values.data()]++;
+            taken++;
+        }
+    }
+    while (deque.pop(out))
+    {
+        seen[out - values.data()]++;
+        taken++;
+    }
+
+    for (auto& i : thieves)
+    {
+        i.join();
+    }
+
+    for (auto& i : seen)
+    {
+        EXPECT_EQ(1, i.load());
+    }
+}
+
+TEST(work_stealing_pool, ShouldExecuteFromOutside)
+{
+    work_stealing_pool<> pool(4, 8);
+    std::atomic<int> ran = 0;
+    for (int i=0; i<1000; i++)
+    {
+        pool.execute([&ran](){ran++;});
+    }
+    pool.wait_until([&ran](){return ran.load() == 1000;});
+    EXPECT_FALSE(pool.in_worker());
+}
+
+static size_t sum(work_stealing_pool<>& p_pool, size_t p_begin, size_t p_end)
+{
+    if (p_end - p_begin <= 64)
+    {
+        size_t rv = 0;
+        for (auto i = p_begin; i < p_end; i++)
+        {
+            rv += i;
+        }
+        return rv;
+    }
+
+    struct half_t
+    {
+        size_t begin;
+        size_t end;
+        size_t result = 0;
+        std::atomic<bool> done = false;
+    };
+
+    auto middle = p_begin + (p_end - p_begin) / 2;
+    half_t right{middle, p_end};
+    p_pool.execute([&p_pool, &right]() {
+            right.result = sum(p_pool, right.begin, right.end);
+            right.done.store(true, std::memory_order_release);
+        });
+    auto left = sum(p_pool, p_begin, middle);
+    p_pool.wait_until([&right](){return right.done.load(std::memory_order_acquire);});
+    return left + right.result;
+}
+
+TEST(work_stealing_pool, ShouldRunNestedForkJoin)
+{
+    work_stealing_pool<> pool(4);
+    constexpr size_t N = 1 << 16;
+
+    std::promise<size_t> result;
+    pool.execute([&]() {
+            EXPECT_TRUE(pool.in_worker());
+            result.set_value(sum(pool, 0, N));
+        });
+    EXPECT_EQ(N*(N-1)/2, result.get_future().get());
+}
+
+TEST(work_stealing_pool, ShouldDrainOnDestruction)
+{
+    std::atomic<int> ran = 0;
+    {
+        work_stealing_pool<> pool(2);
+        for (int i=0; i<100; i++)
+        {
+            pool.execute([&]() {
+                    ran++;
+                    pool.execute([&ran](){ran++;});
+                });
+        }
+    }
+    EXPECT_EQ(200, ran.load());
+}
+
+TEST(work_stealing_pool, ShouldExecuteMoveOnly)
+{
+    work_stealing_pool<unique_light_function<void()>> pool(2);
+    std::promise<int> res;
+    auto value = std::make_unique<int>(42);
+    pool.execute([&res, value = std::move(value)](){res.set_value(*value);});
+    EXPECT_EQ(42, res.get_future().get());
+}